@@ -1,5 +1,6 @@
 TEMPLATE = lib
 CONFIG += c++11
+CONFIG += thread
 CONFIG -= app_bundle
 CONFIG -= qt
 
@@ -29,6 +30,8 @@ QMAKE_EXTRA_COMPILERS += custom_rcc
 HEADERS += \
     src/graphics/opengl/buffer.hpp \
     src/graphics/opengl/shader.hpp \
+    src/graphics/opengl/glstate.hpp \
+    src/graphics/opengl/programcache.hpp \
     src/graphics/scene/material.hpp \
     src/graphics/scene/mesh.hpp \
     src/graphics/scene/stage.hpp \
@@ -41,6 +44,7 @@ HEADERS += \
     src/collision/collision.hpp \
     src/collision/hull.hpp \
     src/graphics/core/view.hpp \
+    src/graphics/core/gpuprofiler.hpp \
     src/events/event.hpp \
     src/input/gamepad.hpp \
     src/input/joystick.hpp \
@@ -73,6 +77,8 @@ HEADERS += \
     src/graphics/debug/debugdrawer.hpp \
     include/acknext/ackdebug.h \
     include/acknext/ackcol.h \
+    include/acknext/ackjob.h \
+    include/acknext/ackcache.h \
     src/collision/collisionsystem.hpp \
     src/audio/audiomanager.hpp \
     src/audio/sound.hpp \
@@ -85,8 +91,15 @@ HEADERS += \
     src/graphics/core/glenum-translator.hpp \
     include/acknext/acff.h \
     src/scene/animation.hpp \
+    src/scene/keyframes.hpp \
     src/graphics/shareddata.hpp \
-    src/graphics/opengl/framebuffer.hpp
+    src/graphics/opengl/framebuffer.hpp \
+    src/core/jobsystem.hpp \
+    src/graphics/scene/drawlist.hpp \
+    src/graphics/scene/lightclusters.hpp \
+    src/graphics/scene/bonepalette.hpp \
+    src/scene/entitystorage.hpp \
+    src/virtfs/resourcecache.hpp
 
 SOURCES += \
     src/graphics/opengl/buffer.cpp \
@@ -113,6 +126,7 @@ SOURCES += \
     src/core/log.cpp \
     src/core/errorhandling.cpp \
     src/graphics/core/graphics-core.cpp \
+    src/graphics/core/gpuprofiler.cpp \
     src/core/globals.cpp \
     src/input/inputmanager.cpp \
     src/input/input-strings.cpp \
@@ -130,6 +144,8 @@ SOURCES += \
     src/virtfs/resourcemanager.cpp \
     src/math/color.cpp \
     src/graphics/opengl/programuniform.cpp \
+    src/graphics/opengl/glstate.cpp \
+    src/graphics/opengl/programcache.cpp \
     src/core/blob_compression.c \
     src/core/engineobject.cpp \
     src/extensions/extension.cpp \
@@ -139,8 +155,15 @@ SOURCES += \
     src/graphics/core/glenum-translator.cpp \
     src/virtfs/ackfile.cpp \
     src/scene/animation.cpp \
+    src/scene/keyframes.cpp \
     src/graphics/opengl/framebuffer.cpp \
-    src/math/aabb.cpp
+    src/math/aabb.cpp \
+    src/core/jobsystem.cpp \
+    src/graphics/scene/drawlist.cpp \
+    src/graphics/scene/lightclusters.cpp \
+    src/graphics/scene/bonepalette.cpp \
+    src/scene/entitystorage.cpp \
+    src/virtfs/resourcecache.cpp
 
 RESOURCES += \
     $$TOPDIR/resource/builtin.qrc
@@ -22,6 +22,8 @@
 #include "acknext/ackdebug.h"
 #include "acknext/ackcol.h"
 #include "acknext/acksound.h"
+#include "acknext/ackjob.h"
+#include "acknext/ackcache.h"
 
 // Global variables
 #include "acknext/ackvars.h"
@@ -32,6 +32,18 @@ static ACKGUID const acff_guidModel =
 	 0x0b, 0x0a, 0x54, 0xf8
 }};
 
+// Model with animation channels stored as compressed key tracks
+static ACKGUID const acff_guidModelCompressed =
+{{
+     0xbd, 0xc4, 0x80, 0x13,
+	 0x78, 0x50, 0x45, 0xd7,
+	 0x87, 0xd3, 0x3e, 0x96,
+	 0x88, 0x2f, 0x6b, 0xf6
+}};
+
+// Version of the compressed key track layout
+static const uint32_t ACFF_ANIMATION_VERSION = 1;
+
 static ACKGUID const acff_guidMaterial =
 {{
      0x32, 0x4c, 0x67, 0x80,
@@ -56,6 +68,18 @@ static ACKGUID const acff_guidMesh =
 		0x32, 0xc5, 0xf3, 0x9b
 }};
 
+// Mesh with vertices and indices stored in their in-memory layout
+static ACKGUID const acff_guidMeshPacked =
+{{
+     0x6c, 0xb3, 0x76, 0x18,
+	 0x1b, 0x1c, 0x4e, 0x5e,
+	 0xb8, 0x58, 0x7a, 0x24,
+	 0xb2, 0x80, 0x1c, 0x17
+}};
+
+// Version of the packed mesh layout, increase when VERTEX or INDEX change
+static const uint32_t ACFF_MESH_VERSION = 1;
+
 static ACKGUID const acff_guidShader =
 {{
      0xd2, 0x47, 0xfb, 0xc8,
@@ -0,0 +1,34 @@
+#ifndef _ACKNEXT_ACKCACHE_H_
+#define _ACKNEXT_ACKCACHE_H_
+
+#include "config.h"
+#include "core.h"
+#include <stddef.h>
+
+// Bitmaps and sounds loaded with bmap_get() and snd_get(), shader
+// sources and the targets of ACFF symlinks that allow caching are
+// shared between all users of the same file. Unused ones stay cached
+// until their type exceeds its budget.
+// Don't modify such shared objects, and release them with the matching
+// *_remove() function, which only drops the reference. bmap_load() and
+// snd_load() always return a private object.
+typedef struct
+{
+	int hits;           // loads served from the cache
+	int misses;         // loads that went to the file system
+	int evictions;      // unused resources dropped because of the budget
+	size_t bytesLoaded; // resource bytes loaded on misses
+	size_t bytesSaved;  // resource bytes served by hits
+	size_t bytesCached; // resource bytes currently in the cache
+} CACHESTATS;
+
+ACKVAR CACHESTATS cache_stats;
+
+// Sets how many bytes of a resource type may stay cached
+// (default: ACKNEXT_CACHE_BUDGET), resources in use are never dropped.
+ACKFUN void cache_setbudget(ACKTYPE type, size_t bytes);
+
+// Drops all cached resources that are not in use
+ACKFUN void cache_flush();
+
+#endif // _ACKNEXT_ACKCACHE_H_
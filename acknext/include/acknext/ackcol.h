@@ -30,6 +30,16 @@ typedef struct
 	var distance;
 } COLLISION;
 
+typedef struct
+{
+	VECTOR from, to;
+	BITFIELD mask;
+
+	// set by c_trace_batch:
+	int ACKCONST firstHit; // index into the result buffer or -1
+	int ACKCONST hitCount;
+} TRACE;
+
 ACKVAR bool debug_collision;
 
 ACKVAR dSpaceID collision_space; // The ODE collision space the game uses
@@ -44,11 +54,28 @@ ACKFUN HULL * hull_createFromExisting(ENTITY * ent, dGeomID geom);
 ACKFUN void hull_remove(HULL * hull);
 
 // Collision API:
+
+// Hull positions are synced once per frame after on_update and
+// before the first trace of a frame, so entities moved between
+// two traces of the same on_update are seen one frame later.
 ACKFUN COLLISION * c_trace(
 	VECTOR const * from,
 	VECTOR const * to,
 	BITFIELD mask);
 
+// Traces all rays and stores the hits sorted by distance per ray in results.
+// Only the closest hit per ray is reported unless TRACE_ALL is set, with
+// TRACE_PARALLEL the rays are spread over the worker threads. Rays that
+// touch trimesh or heightfield hulls are still traced on the calling thread.
+// Hits that do not fit into results are dropped.
+// Returns the number of COLLISIONs written.
+ACKFUN int c_trace_batch(
+	TRACE * traces,
+	int count,
+	COLLISION * results,
+	int capacity,
+	TRACEFLAGS flags);
+
 ACKFUN COLLISION * c_move(
 	ENTITY * ent,
 	VECTOR const * from,
@@ -24,6 +24,8 @@
 #define CLEAR_DEPTH (1<<0)
 #define CLEAR_COLOR (1<<1)
 #define CLEAR_STENCIL (1<<2)
+#define TRACE_ALL (1<<0)
+#define TRACE_PARALLEL (1<<1)
 
 typedef BITFIELD ANIMFLAGS;
 typedef BITFIELD CONFIGFLAGS;
@@ -32,6 +34,7 @@ typedef BITFIELD MOVEFLAGS;
 typedef BITFIELD PPSTAGES;
 typedef BITFIELD SHADERFLAGS;
 typedef BITFIELD STAGEFLAGS;
+typedef BITFIELD TRACEFLAGS;
 typedef BITFIELD VIEWFLAGS;
 typedef BITFIELD WARPFLAGS;
 
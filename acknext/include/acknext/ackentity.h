@@ -31,7 +31,8 @@ typedef struct ENTITY
 	// Visuals
 	MODEL * model;
 	MATERIAL * material;
-	FRAME pose[ACKNEXT_MAX_BONES];
+	FRAME * ACKCONST pose; // one frame per model bone, NULL for models without skeleton
+	int ACKCONST poseCount;
 
 	// Collision
 	struct HULL * ACKCONST mainCollider; // changed by ent_updatehull
@@ -57,12 +58,27 @@ ACKFUN ENTITY * ent_create(
 // should be called when ENTITY::model is changed
 ACKFUN void ent_updatehull(ENTITY * ent);
 
-// Resets the entities pose to the entities models default pose
+// Resets the entities pose to the entities models default pose.
+// Allocates or frees ENTITY::pose when the model has changed.
 ACKFUN void ent_posereset(ENTITY * ent);
 
 // progress: time in seconds
+// Always samples all bones, so the pose can be used by game logic.
+// Channels of compressed model files have no CHANNEL::frames,
+// use chan_sample() to read their keys outside of ent_animate().
 ACKFUN void ent_animate(ENTITY * ent, char const * animation, double progress);
 
+// ent_animate() with an animation from model_getanimation(),
+// playing forward from the last call is O(1) per channel
+ACKFUN void ent_animateExt(ENTITY * ent, ANIMATION const * animation, double progress);
+
+// ent_animateExt() for count entities, spread over the worker threads.
+// Meant for visual animation only: entities drawn far away are sampled
+// less often and with fewer bones (lod_animintervals, lod_bonedepths),
+// entities that were drawn before but not in the last frame are off
+// screen and keep their pose. Use ent_animateExt() for exact poses.
+ACKFUN void ent_animate_many(ENTITY * const * ents, ANIMATION const * const * animations, double const * progress, int count);
+
 ACKFUN void ent_remove(ENTITY * ent);
 
 ACKFUN ENTITY * ent_next(ENTITY const * ent);
@@ -1,6 +1,13 @@
 #ifndef _ACKNEXT_ACKENUM_H_
 #define _ACKNEXT_ACKENUM_H_
 
+typedef enum BROADPHASE {
+	BROADPHASE_SIMPLE,
+	BROADPHASE_HASH,
+	BROADPHASE_QUADTREE,
+	BROADPHASE_SWEEPANDPRUNE,
+} BROADPHASE;
+
 typedef enum CAMERATYPE {
 	PERSPECTIVE,
 	ISOMETRIC,
@@ -29,6 +36,7 @@ typedef enum TASKSTATE {
 	TASK_SUSPENDED,
 	TASK_DISABLED,
 	TASK_RUNNING,
+	TASK_WAITING,
 } TASKSTATE;
 
 
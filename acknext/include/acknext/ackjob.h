@@ -0,0 +1,38 @@
+#ifndef _ACKNEXT_ACKJOB_H_
+#define _ACKNEXT_ACKJOB_H_
+
+#include "config.h"
+#include <stdbool.h>
+
+typedef struct JOB JOB;
+
+typedef void (*JOBFUNCTION)(void * context);
+
+typedef void (*JOBRANGEFUNCTION)(void * context, int begin, int end);
+
+// Runs function(context) on a worker thread as soon as all dependencies
+// are done. dependencies may be NULL when dependencyCount is 0.
+// The returned job must be released with job_remove.
+ACKFUN JOB * job_submit(
+	JOBFUNCTION function,
+	void * context,
+	JOB * const * dependencies,
+	int dependencyCount);
+
+// Waits until the job is done, executes other jobs in the meantime
+ACKFUN void job_wait(JOB * job);
+
+ACKFUN bool job_done(JOB const * job);
+
+// Releases the handle, the job itself will still be executed
+ACKFUN void job_remove(JOB * job);
+
+// Calls function(context, begin, end) for chunks of at most grain elements
+// of [0,count) on all worker threads, returns when all chunks are done.
+ACKFUN void job_parallel_for(
+	int count,
+	int grain,
+	JOBRANGEFUNCTION function,
+	void * context);
+
+#endif // _ACKNEXT_ACKJOB_H_
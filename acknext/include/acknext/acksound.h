@@ -13,6 +13,8 @@ typedef uint32_t SOUNDHANDLE;
 
 ACKFUN SOUND * snd_load(char const * fileName);
 
+ACKFUN SOUND * snd_get(char const * fileName); // uses caching, see ackcache.h
+
 ACKFUN void snd_remove(SOUND * snd);
 
 ACKFUN SOUNDHANDLE snd_play(SOUND * sound, var volume);
@@ -36,6 +36,22 @@
 #define ACKNEXT_MAX_BONES        256
 #define ACKNEXT_MAX_FRAMEBUFFER_TARGETS 8
 
+// Clustered lighting: lights are sorted into a view space grid
+// of X*Y screen tiles and Z depth slices
+#define ACKNEXT_CLUSTER_X        16
+#define ACKNEXT_CLUSTER_Y        9
+#define ACKNEXT_CLUSTER_Z        24
+#define ACKNEXT_CLUSTER_LIGHTS   128 // per cluster, further lights are dropped
+
+// Broadphase tuning, see ACKCONFIG::broadphase
+#define ACKNEXT_HASHSPACE_MINLEVEL  -2     // smallest cell is 2^-2
+#define ACKNEXT_HASHSPACE_MAXLEVEL  8      // largest cell is 2^8
+#define ACKNEXT_QUADTREE_EXTENTS    4096.0 // half size of the world
+#define ACKNEXT_QUADTREE_DEPTH      8
+
+// Default byte budget per resource type, see cache_setbudget
+#define ACKNEXT_CACHE_BUDGET (256 * 1024 * 1024)
+
 typedef unsigned int uint;
 
 #endif // _ACKNEXT_CONFIG_H_
@@ -64,6 +64,8 @@ ACKFUN BITMAP * bmap_createpixel(COLOR color);
 
 ACKFUN BITMAP * bmap_load(char const * fileName);
 
+ACKFUN BITMAP * bmap_get(char const * fileName); // uses caching, see ackcache.h
+
 
 ACKFUN BITMAP * bmap_read(ACKFILE * file);
 
@@ -129,6 +131,8 @@ ACKFUN void buffer_remove(BUFFER * buffer);
 
 ACKFUN SHADER * shader_create();
 
+// Sources are compiled by shader_link, which also reports compile errors.
+// Linked programs are cached in "shadercache/" of the write directory.
 ACKFUN bool shader_addSource(SHADER * shader, GLenum type, char const * source);
 
 ACKFUN bool shader_addSourceExt(SHADER * shader, GLenum type, void const * source, size_t length);
@@ -50,13 +50,32 @@ typedef struct
 	VSYNC vsync;
 
 	CONFIGFLAGS flags;
+
+	BROADPHASE broadphase; // collision space type, used by engine_open
+
+	int workerThreads; // number of job threads, -1 uses one per additional core, 0 runs all jobs on the main thread
 } ACKCONFIG;
 
 typedef struct
 {
 	int drawcalls;
+	int stateChanges; // shader, material, cull mode and mesh changes between draw groups
+	int stateChangesAvoided; // by sorting the draw groups by state
+	int glCalls; // GL state changes and uniform uploads issued
+	int glCallsElided; // skipped because the state was already set
 	long long polygons; // Number of polygons
 	float gpuTime; // GPU time in milliseconds for all drawcalls
+
+	// GPU time of the render stages in milliseconds
+	float gpuScene;
+	float gpuSSAO;
+	float gpuBloom;
+	float gpuTonemap;
+	float gpuFXAA;
+	float gpuDebug;
+
+	// polygons and the gpu times are from the frame this many frames ago
+	int gpuLatency;
 } ENGINESTATS;
 
 ACKVAR ACKCONFIG engine_config;
@@ -95,6 +114,9 @@ ACKVAR char const * ACKCONST engine_lasterror_text;
 
 ACKFUN void obj_setvar(void * obj, char const * name, GLenum type, ...);
 
+// The returned pointer refers to the property storage of obj and is
+// only valid until the next obj_setvar on the same object or until
+// the object is removed, copy the value instead of keeping the pointer.
 ACKFUN void const * obj_getvar(void * obj, char const * name, GLenum * type);
 
 ACKFUN void obj_listvar(void const * obj);
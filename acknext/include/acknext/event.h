@@ -10,12 +10,20 @@ typedef struct
 
 typedef void (*EVENTHANDLER)(void * arg);
 
+typedef void (*EVENTHANDLEREXT)(void * context, void * arg);
+
 ACKFUN EVENT * event_create();
 
 ACKFUN void event_attach(EVENT ACKCONST * ev, EVENTHANDLER handler);
 
 ACKFUN void event_detach(EVENT ACKCONST * ev, EVENTHANDLER handler);
 
+// Attaches a handler that gets context passed in addition to the event argument.
+// Each handler/context pair is attached only once.
+ACKFUN void event_attachExt(EVENT ACKCONST * ev, EVENTHANDLEREXT handler, void * context);
+
+ACKFUN void event_detachExt(EVENT ACKCONST * ev, EVENTHANDLEREXT handler, void * context);
+
 ACKFUN void event_clear(EVENT ACKCONST * ev);
 
 ACKFUN void event_invoke(EVENT ACKCONST * ev, void * arg);
@@ -34,6 +34,11 @@ ACKFUN bool file_eof(ACKFILE * file);
 
 ACKFUN void file_flush(ACKFILE * file);
 
+// Returns the next size bytes of the file without copying and skips them.
+// Returns NULL if the file is not accessible in memory, use file_read then.
+// The pointer is valid until the file is closed.
+ACKFUN void const * file_view(ACKFILE * file, uint32_t size);
+
 ACKFUN void file_close(ACKFILE * file);
 
 #endif // _ACKNEXT_FILESYS_H_
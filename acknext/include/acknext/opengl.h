@@ -40,4 +40,7 @@ ACKFUN void opengl_draw(
 
 ACKFUN void opengl_drawDebug(MATRIX * const matView, MATRIX * const matProj);
 
+// Must be called after changing GL state without the opengl_* functions
+ACKFUN void opengl_resetState();
+
 #endif // _ACKNEXT_OPENGL_H_
@@ -88,7 +88,7 @@ typedef struct
 {
 	int targetBone; // The bone that will be animated
 	int frameCount;
-	FRAME * ACKCONST frames;
+	FRAME * ACKCONST frames; // NULL for channels loaded from compressed model files, see chan_sample()
 } CHANNEL;
 
 // managed type
@@ -179,12 +179,23 @@ ACKFUN void model_reshape(MODEL * model, int meshC, int boneC, int animC);
 
 ACKFUN void model_updateBoundingBox(MODEL * model, bool updateMeshes);
 
+// Rebuilds the default pose and bone hierarchy of the model,
+// must be called after MODEL::bones has changed
+ACKFUN void model_updateBones(MODEL * model);
+
+// NULL if the model has no animation of that name
+ACKFUN ANIMATION * model_getanimation(MODEL const * model, char const * name);
+
 // animation api:
 
 ACKFUN CHANNEL * chan_create(int frames);
 
 ACKFUN void chan_remove(CHANNEL * chan);
 
+// Stores the interpolated frame of the channel at time in frame.
+// Works for channels of compressed model files which have no frames.
+ACKFUN FRAME * chan_sample(CHANNEL const * chan, double time, FRAME * frame);
+
 ACKFUN ANIMATION * anim_create(char const * name, int channels);
 
 ACKFUN void anim_remove(ANIMATION * anim);
@@ -192,6 +203,10 @@ ACKFUN void anim_remove(ANIMATION * anim);
 // render api:
 ACKVAR var lod_distances[16]; // The distances for each of the 16 LOD stages. Should be strictly monotonically increasing
 
+ACKVAR int lod_animintervals[16]; // ent_animate_many() samples entities in a LOD stage only every n-th frame
+
+ACKVAR int lod_bonedepths[16]; // ent_animate_many() skips bones deeper in the hierarchy than this in a LOD stage
+
 ACKVAR CAMERA * ACKCONST camera;
 
 ACKVAR COLOR sky_color;
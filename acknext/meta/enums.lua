@@ -26,6 +26,7 @@ enum.TASKSTATE =
 	"SUSPENDED",
 	"DISABLED",
 	"RUNNING",
+	"WAITING",
 }
 
 enum.CAMERATYPE =
@@ -34,3 +35,12 @@ enum.CAMERATYPE =
 	"Isometric",
 	"Custom_Projection",
 }
+
+enum.BROADPHASE =
+{
+	prefix = "BROADPHASE_",
+	"Simple",
+	"Hash",
+	"QuadTree",
+	"SweepAndPrune",
+}
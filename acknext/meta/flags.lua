@@ -38,6 +38,11 @@ flags.CONFIGFLAGS =
 	"VFS_Use_Cwd",
 	"Silent_Fail"
 }
+flags.TRACEFLAGS =
+{
+	"Trace_All",
+	"Trace_Parallel",
+}
 flags.ANIMFLAGS = 
 {
 	"Looped",
@@ -1,4 +1,5 @@
 #include "sound.hpp"
+#include "../virtfs/resourcecache.hpp"
 
 Sound::Sound(Mix_Chunk * chunk) :
     EngineObject<SOUND>(),
@@ -37,8 +38,26 @@ ACKNEXT_API_BLOCK
 		return demote(new Sound(chunk));
 	}
 
+	SOUND * snd_get(char const * fileName)
+	{
+		ARG_NOTNULL(fileName, nullptr);
+
+		SOUND * cached = (SOUND*)ResourceCache::acquire(TYPE_SOUND, fileName);
+		if(cached != nullptr) {
+			return cached;
+		}
+		SOUND * sound = snd_load(fileName);
+		if(sound != nullptr) {
+			ResourceCache::insert(TYPE_SOUND, fileName, sound, promote<Sound>(sound)->chunk->alen);
+		}
+		return sound;
+	}
+
 	void snd_remove(SOUND * snd)
 	{
+		if(ResourceCache::release(snd)) {
+			return;
+		}
 		Sound * sound = promote<Sound>(snd);
 		if(sound) {
 			delete sound;
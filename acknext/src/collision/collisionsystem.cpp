@@ -2,8 +2,15 @@
 
 #include "hull.hpp"
 
+#include "../core/jobsystem.hpp"
+
 #include <vector>
 #include <algorithm>
+#include <atomic>
+#include <thread>
+
+static std::vector<Hull*> hulls;
+static int lastSync = -1;
 
 void CollisionSystem::initialize()
 {
@@ -11,25 +18,70 @@ void CollisionSystem::initialize()
 	dAllocateODEDataForThread(dAllocateMaskAll);
 	engine_log("ODE Config: %s", dGetConfiguration());
 
+	switch(engine_config.broadphase)
+	{
+		case BROADPHASE_SIMPLE:
+			engine_log("Using simple collision space.");
+			collision_space = dSimpleSpaceCreate(0);
+			break;
+		case BROADPHASE_QUADTREE: {
+			engine_log("Using quadtree collision space.");
+			dVector3 center = { 0, 0, 0, 0 };
+			dVector3 extents = {
+				ACKNEXT_QUADTREE_EXTENTS,
+				ACKNEXT_QUADTREE_EXTENTS,
+				ACKNEXT_QUADTREE_EXTENTS,
+				0
+			};
+			collision_space = dQuadTreeSpaceCreate(0, center, extents, ACKNEXT_QUADTREE_DEPTH);
+			break;
+		}
+		case BROADPHASE_SWEEPANDPRUNE:
+			engine_log("Using sweep and prune collision space.");
+			// y is up, so sort along the ground plane first
+			collision_space = dSweepAndPruneSpaceCreate(0, dSAP_AXES_XZY);
+			break;
+		case BROADPHASE_HASH:
+		default:
+			engine_log("Using hash collision space.");
+			collision_space = dHashSpaceCreate(0);
+			dHashSpaceSetLevels(
+				collision_space,
+				ACKNEXT_HASHSPACE_MINLEVEL,
+				ACKNEXT_HASHSPACE_MAXLEVEL);
+			break;
+	}
 
-	// collision_space = dHashSpaceCreate(0);
-	collision_space = dSimpleSpaceCreate(0);
+	lastSync = -1;
 }
 
 void CollisionSystem::update()
 {
-	int count = dSpaceGetNumGeoms(collision_space);
-	std::vector<dGeomID> geoms(count);
+	// Hull::update() is a no-op for hulls which did not move
+	for(Hull * hull : hulls)
+		hull->update();
+	lastSync = total_frames;
+}
 
-	for(int i = 0; i < count; i++)
-	{
-		geoms[i] = dSpaceGetGeom(collision_space, i);
-	}
+void CollisionSystem::sync()
+{
+	if(lastSync != total_frames)
+		CollisionSystem::update();
+}
 
-	for(dGeomID g : geoms)
-	{
-		Hull::fromGeom(g)->update();
-	}
+void CollisionSystem::addHull(Hull * hull)
+{
+	hull->registryIndex = hulls.size();
+	hulls.push_back(hull);
+}
+
+void CollisionSystem::removeHull(Hull * hull)
+{
+	size_t index = hull->registryIndex;
+	assert(index < hulls.size() && hulls[index] == hull);
+	hulls[index] = hulls.back();
+	hulls[index]->registryIndex = index;
+	hulls.pop_back();
 }
 
 #pragma GCC diagnostic push
@@ -114,72 +166,81 @@ static COLLISION * allocTempCollision()
 		sizeof(COLLISION)));
 }
 
-struct TraceFeedback
+// Rays handled by one worker in one go
+#define TRACE_GRAIN 32
+
+// Scratch data of one worker, kept between batches
+struct TraceWorker
 {
-	std::vector<COLLISION> collisions;
+	dGeomID ray = nullptr;
+	std::vector<COLLISION> hits;
 };
 
-static void dTraceCallback (void *data, dGeomID o1, dGeomID o2)
+struct TraceGather
 {
-	// Support sub-space collisions :)
-	if (dGeomIsSpace (o1) || dGeomIsSpace (o2)) {
-		// from: https://www.ode-wiki.org/wiki/index.php?title=Manual:_Collision_Detection#Collision_detection
+	dGeomID ray;
+	std::vector<dGeomID> * candidates;
+};
 
-		// colliding a space with something :
-		dSpaceCollide2 (o1, o2, data, &dTraceCallback);
+static std::vector<TraceWorker> traceWorkers;
+static std::vector<dGeomID> traceCandidates;
+static std::vector<size_t> traceOffsets;
+static std::vector<int> traceOrder;
+static dGeomID traceProbe = nullptr;
 
-		// collide all geoms internal to the space(s)
-		if (dGeomIsSpace (o1))
-			dSpaceCollide ((dSpaceID)o1, data, &dTraceCallback);
-		if (dGeomIsSpace (o2))
-			dSpaceCollide ((dSpaceID)o2, data, &dTraceCallback);
-
-		return;
-	}
+// ODE needs per-thread data for some colliders (trimesh)
+static thread_local bool odeThreadReady = false;
 
+// Only collects the geoms the broadphase found,
+// the actual ray tests are done later.
+static void dTraceGatherCallback(void *data, dGeomID o1, dGeomID o2)
+{
+	// Support sub-space collisions :)
 	if (dGeomIsSpace (o1) || dGeomIsSpace (o2)) {
-		engine_log("Subspace collision detected! Not supported yet!");
+		dSpaceCollide2 (o1, o2, data, &dTraceGatherCallback);
 		return;
 	}
 
-	TraceFeedback * feedback = reinterpret_cast<TraceFeedback*>(data);
-
-	// colliding two non-space geoms, so generate contact
-	// points between o1 and o2
-
-	dContactGeom contacts[ACKNEXT_MAX_CONTACTS];
-
-	int num_contact = dCollide(
-		o1,
-		o2,
-		(0xFFFF & ACKNEXT_MAX_CONTACTS),
-		contacts,
-		sizeof(dContactGeom));
-	if(num_contact <= 0) {
-		return;
-	}
+	TraceGather * gather = reinterpret_cast<TraceGather*>(data);
+	gather->candidates->push_back((o1 == gather->ray) ? o2 : o1);
+}
 
-	for(int i = 0; i < num_contact; i++)
+// Trimesh and heightfield colliders keep per-geom state, so the
+// same geom must not be tested by several threads at once.
+static bool isStateless(dGeomID geom)
+{
+	switch(dGeomGetClass(geom))
 	{
-		dContactGeom const & c = contacts[i];
-
-		COLLISION col;
-		col.contact.x = c.pos[0];
-		col.contact.y = c.pos[1];
-		col.contact.z = c.pos[2];
-
-		col.normal.x = -c.normal[0];
-		col.normal.y = -c.normal[1];
-		col.normal.z = -c.normal[2];
+		case dSphereClass:
+		case dBoxClass:
+		case dCapsuleClass:
+		case dCylinderClass:
+		case dPlaneClass:
+			return true;
+		default:
+			return false;
+	}
+}
 
-		if(dGeomGetClass(c.g1) == dRayClass) {
-			col.hull = demote(Hull::fromGeom(c.g2));
-		} else {
-			col.hull = demote(Hull::fromGeom(c.g1));
-		}
+static void setupRay(dGeomID ray, TRACE const & trace)
+{
+	VECTOR dir;
+	vec_diff(&dir, &trace.to, &trace.from);
+	var length = vec_length(&dir);
+	vec_normalize(&dir, 1);
+
+	dGeomRaySetLength(ray, length);
+	dGeomRaySet(
+		ray,
+		trace.from.x, trace.from.y, trace.from.z,
+		dir.x, dir.y, dir.z);
+}
 
-		feedback->collisions.emplace_back(col);
-	}
+static dGeomID createRay()
+{
+	dGeomID ray = dCreateRay(0, 1);
+	dGeomSetCategoryBits(ray, 0);
+	return ray;
 }
 
 ACKNEXT_API_BLOCK
@@ -188,54 +249,193 @@ ACKNEXT_API_BLOCK
 
 	dSpaceID collision_space = nullptr;
 
-	ACKFUN COLLISION * c_trace(VECTOR const * _from, VECTOR const * _to, BITFIELD mask)
+	ACKFUN COLLISION * c_trace(VECTOR const * from, VECTOR const * to, BITFIELD mask)
 	{
-		CollisionSystem::update(); // This should be improved...
-
-		VECTOR from = *_from;
-		VECTOR to = *_to;
-		VECTOR * dist = vec_diff(nullptr, &to, &from);
-
-		dGeomID ray = dCreateRay(0, vec_length(dist));
-		dGeomSetCollideBits(ray, mask);
-		dGeomSetCategoryBits(ray, 0);
-
-		vec_normalize(dist, 1);
-		dGeomRaySet(
-			ray,
-			from.x, from.y, from.z,
-			dist->x, dist->y, dist->z);
-
-		TraceFeedback feedback;
-		dSpaceCollide2(
-			reinterpret_cast<dGeomID>(collision_space),
-			ray,
-			&feedback,
-			dTraceCallback);
-
-		if(feedback.collisions.size() == 0) {
+		ARG_NOTNULL(from, nullptr);
+		ARG_NOTNULL(to, nullptr);
+
+		TRACE trace;
+		memset(&trace, 0, sizeof(TRACE));
+		trace.from = *from;
+		trace.to = *to;
+		trace.mask = mask;
+
+		COLLISION hit;
+		if(c_trace_batch(&trace, 1, &hit, 1, 0) == 0) {
 			return nullptr;
 		}
 
-		for(COLLISION &c : feedback.collisions) {
-			c.distance = vec_dist(&from, &c.contact);
+		COLLISION *tmp = allocTempCollision();
+		*tmp = hit;
+		return tmp;
+	}
+
+	ACKFUN int c_trace_batch(TRACE * traces, int count, COLLISION * results, int capacity, TRACEFLAGS flags)
+	{
+		if(count <= 0)
+			return 0;
+		ARG_NOTNULL(traces, 0);
+		ARG_NOTNULL(results, 0);
+
+		CollisionSystem::sync();
+
+		// Broadphase on the calling thread, ODE spaces are not
+		// safe to query concurrently. This also makes sure all
+		// AABBs are clean before the workers read the geoms.
+		dSpaceClean(collision_space);
+
+		if(traceProbe == nullptr)
+			traceProbe = createRay();
+
+		traceCandidates.clear();
+		traceOffsets.resize(count + 1);
+
+		TraceGather gather;
+		gather.ray = traceProbe;
+		gather.candidates = &traceCandidates;
+		for(int i = 0; i < count; i++)
+		{
+			traceOffsets[i] = traceCandidates.size();
+			setupRay(traceProbe, traces[i]);
+			dGeomSetCollideBits(traceProbe, traces[i].mask);
+			dSpaceCollide2(
+				reinterpret_cast<dGeomID>(collision_space),
+				traceProbe,
+				&gather,
+				&dTraceGatherCallback);
+		}
+		traceOffsets[count] = traceCandidates.size();
+
+		// Rays that only hit stateless geoms go first and may run in
+		// parallel, the others are traced on the calling thread.
+		bool parallel = (flags & TRACE_PARALLEL) != 0;
+		traceOrder.clear();
+		for(int i = 0; i < count; i++)
+		{
+			bool stateless = true;
+			for(size_t c = traceOffsets[i]; c < traceOffsets[i + 1] && stateless; c++)
+				stateless = isStateless(traceCandidates[c]);
+			if(stateless || !parallel)
+				traceOrder.push_back(i);
+		}
+		size_t const parallelCount = parallel ? traceOrder.size() : 0;
+		if(parallel)
+		{
+			for(int i = 0, p = 0; i < count; i++)
+			{
+				if(p < int(parallelCount) && traceOrder[p] == i)
+					p++;
+				else
+					traceOrder.push_back(i);
+			}
+		}
+
+		// One slot per worker plus one for the calling thread, which
+		// might not be a worker of the job system at all.
+		size_t const workers = parallel ? JobSystem::size() : 0;
+		size_t const callerSlot = workers;
+		if(traceWorkers.size() < workers + 1)
+			traceWorkers.resize(workers + 1);
+		for(size_t i = 0; i <= workers; i++) {
+			if(traceWorkers[i].ray == nullptr)
+				traceWorkers[i].ray = createRay();
 		}
+		std::thread::id const caller = std::this_thread::get_id();
 
-		std::sort(
-			feedback.collisions.begin(),
-			feedback.collisions.end(),
-			[](COLLISION & l, COLLISION & r) {
-				return l.distance < r.distance;
-			});
+		bool allHits = (flags & TRACE_ALL) != 0;
+		std::atomic<int> cursor(0);
 
-		// TODO: Store multiple trace results in
-		// user-accessible array
+		auto narrowphase = [&](size_t begin, size_t end, TraceWorker & self)
+		{
+			if(!odeThreadReady) {
+				dAllocateODEDataForThread(dAllocateMaskAll);
+				odeThreadReady = true;
+			}
 
-		dGeomDestroy(ray);
+			dGeomID ray = self.ray;
+
+			// With a closest hit ray, ODE reports only the nearest
+			// contact per geom instead of all of them.
+			dGeomRaySetClosestHit(ray, allHits ? 0 : 1);
+
+			for(size_t k = begin; k < end; k++)
+			{
+				int const i = traceOrder[k];
+				TRACE & trace = traces[i];
+				setupRay(ray, trace);
+
+				self.hits.clear();
+				for(size_t c = traceOffsets[i]; c < traceOffsets[i + 1]; c++)
+				{
+					dContactGeom contacts[ACKNEXT_MAX_CONTACTS];
+					int num = dCollide(
+						ray,
+						traceCandidates[c],
+						allHits ? (0xFFFF & ACKNEXT_MAX_CONTACTS) : 1,
+						contacts,
+						sizeof(dContactGeom));
+					for(int n = 0; n < num; n++)
+					{
+						dContactGeom const & contact = contacts[n];
+
+						COLLISION col;
+						col.contact.x = contact.pos[0];
+						col.contact.y = contact.pos[1];
+						col.contact.z = contact.pos[2];
+
+						// The ray is the first geom, so this is the surface normal
+						col.normal.x = contact.normal[0];
+						col.normal.y = contact.normal[1];
+						col.normal.z = contact.normal[2];
+
+						col.hull = demote(Hull::fromGeom(traceCandidates[c]));
+						col.distance = contact.depth; // depth of a ray contact is its distance
+
+						if(allHits) {
+							self.hits.push_back(col);
+						} else if(self.hits.size() == 0) {
+							self.hits.push_back(col);
+						} else if(col.distance < self.hits[0].distance) {
+							self.hits[0] = col;
+						}
+					}
+
+					// Early out: nothing behind the nearest hit is interesting
+					if(!allHits && self.hits.size() > 0)
+						dGeomRaySetLength(ray, self.hits[0].distance);
+				}
+
+				if(allHits) {
+					std::sort(
+						self.hits.begin(),
+						self.hits.end(),
+						[](COLLISION const & l, COLLISION const & r) {
+							return l.distance < r.distance;
+						});
+				}
+
+				int num = int(self.hits.size());
+				int first = cursor.fetch_add(num);
+				if(first >= capacity) {
+					num = 0;
+				} else if(first + num > capacity) {
+					num = capacity - first;
+				}
+				if(num > 0)
+					memcpy(&results[first], self.hits.data(), sizeof(COLLISION) * num);
+
+				trace.firstHit = (num > 0) ? first : -1;
+				trace.hitCount = num;
+			}
+		};
 
-		COLLISION *tmp = allocTempCollision();
-		*tmp = feedback.collisions[0];
-		return tmp;
-	}
+		JobSystem::parallelFor(parallelCount, TRACE_GRAIN, [&](size_t begin, size_t end, int worker)
+		{
+			bool const isCaller = (std::this_thread::get_id() == caller);
+			narrowphase(begin, end, traceWorkers[isCaller ? callerSlot : worker]);
+		});
+		narrowphase(parallelCount, count, traceWorkers[callerSlot]);
 
+		return std::min(cursor.load(), capacity);
+	}
 }
@@ -6,6 +6,8 @@
 #include <ode/ode.h>
 #include <ode/collision.h>
 
+class Hull;
+
 class CollisionSystem
 {
 public:
@@ -13,8 +15,16 @@ public:
 
 	static void initialize();
 
+	// Pushes all moved hulls into ODE
 	static void update();
 
+	// update(), but only if it did not happen this frame yet
+	static void sync();
+
+	static void addHull(Hull * hull);
+
+	static void removeHull(Hull * hull);
+
 	static void draw();
 
 	static void shutdown();
@@ -5,18 +5,26 @@
 
 Hull::Hull(ENTITY * owner, dGeomID geom) :
     owner(owner),
-    geom(geom)
+    geom(geom),
+    registryIndex(0),
+    syncedVersion(0),
+    syncedCategories(0),
+    synced(false)
 {
 	dGeomSetData(this->geom, this);
 
 	api().entity = this->owner;
 	api().type = dGeomGetClass(this->geom);
 
+	CollisionSystem::addHull(this);
+
 	this->update();
 }
 
 Hull::~Hull()
 {
+	CollisionSystem::removeHull(this);
+
 	dGeomSetData(this->geom, nullptr);
 	dGeomDestroy(this->geom);
 }
@@ -28,7 +36,19 @@ Hull * Hull::fromGeom(dGeomID geom)
 
 void Hull::update()
 {
-	dGeomSetCategoryBits(this->geom, api().entity->categories);
+	if(!this->synced || this->syncedCategories != api().entity->categories)
+	{
+		dGeomSetCategoryBits(this->geom, api().entity->categories);
+		this->syncedCategories = api().entity->categories;
+	}
+
+	Entity * entity = promote<Entity>(this->owner);
+	entity->refreshTransform();
+
+	if(this->synced && this->syncedVersion == entity->transformVersion())
+		return;
+	this->syncedVersion = entity->transformVersion();
+	this->synced = true;
 
 	if(dGeomGetClass(this->geom) == dHeightfieldClass)
 		return;
@@ -13,11 +13,17 @@ public:
 public:
 	ENTITY * owner;
 	dGeomID geom;
+	size_t registryIndex; // managed by CollisionSystem
+private:
+	uint32_t syncedVersion;
+	BITFIELD syncedCategories;
+	bool synced;
 public:
 	Hull(ENTITY * owner, dGeomID geom);
 	NOCOPY(Hull);
 	~Hull();
 
+	// Pushes the owners transform into ODE when it has changed
 	void update();
 };
 
@@ -9,4 +9,6 @@ ACKCONFIG engine_config =
     resolution:   { 1280, 720 },
     vsync:        VSYNC_ADAPTIVE,
     flags:        USE_VFS | VFS_USE_CWD,
+    broadphase:   BROADPHASE_HASH,
+    workerThreads: -1,
 };
@@ -5,6 +5,73 @@
 #include <string.h>
 #include <stdarg.h>
 
+#include <deque>
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <algorithm>
+#include <mutex>
+
+static size_t nameHash(char const * str)
+{
+	size_t hash = 5381;
+	while(*str)
+		hash = 33 * hash + uint8_t(*str++);
+	return hash;
+}
+
+struct Name
+{
+	std::string str;
+	size_t hash;
+	PropertyID id;
+};
+
+// Insert-only open addressing table. Readers don't lock: slots are only
+// ever filled, and a full table is replaced by a larger copy. Replaced
+// tables are kept, readers may still use them.
+struct NameTable
+{
+	size_t mask;
+	std::unique_ptr<std::atomic<Name const *>[]> slots;
+
+	explicit NameTable(size_t size) : mask(size - 1), slots(new std::atomic<Name const *>[size])
+	{
+		for(size_t i = 0; i < size; i++)
+			slots[i].store(nullptr, std::memory_order_relaxed);
+	}
+
+	Name const * find(char const * str, size_t hash) const
+	{
+		for(size_t i = hash & mask; ; i = (i + 1) & mask)
+		{
+			Name const * name = slots[i].load(std::memory_order_acquire);
+			if(name == nullptr || (name->hash == hash && name->str == str))
+				return name;
+		}
+	}
+
+	void insert(Name const * name)
+	{
+		size_t i = name->hash & mask;
+		while(slots[i].load(std::memory_order_relaxed) != nullptr)
+			i = (i + 1) & mask;
+		slots[i].store(name, std::memory_order_release);
+	}
+};
+
+// Indexed by ID, deque keeps the entries stable. Guarded by namesLock,
+// which only serializes intern and str.
+static std::deque<Name> names(1, Name { std::string(), 0, PropertyName::invalid });
+static std::vector<std::unique_ptr<NameTable>> tables;
+static std::atomic<NameTable const *> table(nullptr);
+static std::mutex namesLock;
+
+static uint64_t nextStamp = 1;
+
+static Property const noProperty;
+
 Property::Property(GLenum type, Value const & value)
 {
 	this->set(type, value);
@@ -16,7 +83,64 @@ void Property::set(GLenum type, Value const & value)
 	this->data = value;
 }
 
-BaseEngineObject::BaseEngineObject() : magic(0xBADC0DED)
+PropertyID PropertyName::intern(char const * name)
+{
+	std::lock_guard<std::mutex> _(namesLock);
+	size_t const hash = nameHash(name);
+	NameTable * current = tables.empty() ? nullptr : tables.back().get();
+	if(current != nullptr)
+	{
+		Name const * known = current->find(name, hash);
+		if(known != nullptr)
+			return known->id;
+	}
+
+	PropertyID id = names.size();
+	names.push_back(Name { std::string(name), hash, id });
+
+	// Kept at most half full, so probing stays short and ends
+	size_t const size = current ? (current->mask + 1) : 0;
+	if(2 * names.size() > size)
+	{
+		NameTable * grown = new NameTable(std::max<size_t>(64, 2 * size));
+		for(size_t i = 1; i < names.size(); i++)
+			grown->insert(&names[i]);
+		tables.emplace_back(grown);
+		table.store(grown, std::memory_order_release);
+	}
+	else
+	{
+		current->insert(&names.back());
+	}
+	return id;
+}
+
+PropertyID PropertyName::find(char const * name)
+{
+	NameTable const * current = table.load(std::memory_order_acquire);
+	if(current == nullptr)
+		return invalid;
+	Name const * known = current->find(name, nameHash(name));
+	return known ? known->id : invalid;
+}
+
+char const * PropertyName::str(PropertyID id)
+{
+	std::lock_guard<std::mutex> _(namesLock);
+	if(id >= names.size())
+		return nullptr;
+	return names[id].str.c_str();
+}
+
+static bool lessID(std::pair<PropertyID, Property> const & entry, PropertyID id)
+{
+	return entry.first < id;
+}
+
+BaseEngineObject::BaseEngineObject() :
+    magic(0xBADC0DED),
+    properties(),
+    propertyStamp(nextStamp++)
 {
 
 }
@@ -26,19 +150,34 @@ BaseEngineObject::~BaseEngineObject()
 
 }
 
-void BaseEngineObject::removeProperty(std::string const & name)
+void BaseEngineObject::removeProperty(PropertyID id)
 {
-	this->properties.erase(name);
+	auto it = std::lower_bound(this->properties.begin(), this->properties.end(), id, lessID);
+	if(it == this->properties.end() || it->first != id)
+		return;
+	this->properties.erase(it);
+	this->propertyStamp = nextStamp++;
 }
 
-void BaseEngineObject::setProperty(std::string const & name, Property const & value)
+void BaseEngineObject::setProperty(PropertyID id, Property const & value)
 {
-	this->properties[name] = value;
+	auto it = std::lower_bound(this->properties.begin(), this->properties.end(), id, lessID);
+	if(it != this->properties.end() && it->first == id) {
+		if(it->second.type != value.type)
+			this->propertyStamp = nextStamp++;
+		it->second = value;
+	} else {
+		this->properties.emplace(it, id, value);
+		this->propertyStamp = nextStamp++;
+	}
 }
 
-Property const & BaseEngineObject::getProperty(std::string const & name) const
+Property const & BaseEngineObject::getProperty(PropertyID id) const
 {
-	return this->properties[name];
+	auto it = std::lower_bound(this->properties.begin(), this->properties.end(), id, lessID);
+	if(it == this->properties.end() || it->first != id)
+		return noProperty;
+	return it->second;
 }
 
 ACKNEXT_API_BLOCK
@@ -97,7 +236,8 @@ ACKNEXT_API_BLOCK
 
 		Dummy * ptr = promote<Dummy>(reinterpret_cast<DUMMY*>(obj));
 		ARG_NOTNULL(obj,);
-		ptr->setProperty(name, Property(type, value));
+		ARG_NOTNULL(name,);
+		ptr->setProperty(PropertyName::intern(name), Property(type, value));
 	}
 
 	void const * obj_getvar(void * obj, char const * name, GLenum * type)
@@ -105,7 +245,7 @@ ACKNEXT_API_BLOCK
 		Dummy * ptr = promote<Dummy>(reinterpret_cast<DUMMY*>(obj));
 		ARG_NOTNULL(obj, nullptr);
 		ARG_NOTNULL(name, nullptr);
-		auto const & prop = ptr->getProperty(name);
+		auto const & prop = ptr->getProperty(PropertyName::find(name));
 		if(type != nullptr) {
 			*type = prop.type;
 		}
@@ -126,7 +266,7 @@ ACKNEXT_API_BLOCK
 		engine_log("Properties(%p):", obj);
 		for(auto const & prop : ptr->properties)
 		{
-			char const * name = prop.first.c_str();
+			char const * name = PropertyName::str(prop.first);
 			Property const & p = prop.second;
 			if(p.isSampler())
 			{
@@ -4,11 +4,12 @@
 #include <GL/gl3w.h>
 
 #include <stddef.h>
+#include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
 
-#include <map>
-#include <string>
+#include <vector>
+#include <utility>
 
 #include <acknext.h>
 
@@ -40,6 +41,26 @@ struct Property
 	static bool isSampler(GLenum type);
 };
 
+// Property names are interned once, objects store the ID.
+// The name table is shared and may be used from any thread.
+typedef uint32_t PropertyID;
+
+class PropertyName
+{
+public:
+	static const PropertyID invalid = 0;
+
+	PropertyName() = delete;
+
+	// Returns the ID of name, registers it on first use
+	static PropertyID intern(char const * name);
+
+	// Returns invalid if name was never interned, never blocks
+	static PropertyID find(char const * name);
+
+	static char const * str(PropertyID id);
+};
+
 extern "C" void obj_listvar(void const*);
 
 class BaseEngineObject
@@ -47,16 +68,21 @@ class BaseEngineObject
 	friend void obj_listvar(void const *);
 public:
 	const uint32_t magic;
-	mutable std::map<std::string, Property> properties;
+	// Sorted by ID, objects have only a handful of properties
+	std::vector<std::pair<PropertyID, Property>> properties;
+	// Changes when properties are added, removed or change their type,
+	// unique across all objects so caches can key on (object, stamp)
+	uint64_t propertyStamp;
 protected:
 	explicit BaseEngineObject();
 	virtual ~BaseEngineObject();
 public:
-	void removeProperty(std::string const & name);
+	void removeProperty(PropertyID id);
 
-	void setProperty(std::string const & name, Property const & value);
+	void setProperty(PropertyID id, Property const & value);
 
-	Property const & getProperty(std::string const & name) const;
+	// Returns a property of type GL_NONE if there is none
+	Property const & getProperty(PropertyID id) const;
 };
 
 template<typename T>
@@ -68,8 +94,9 @@ public:
 	static const ptrdiff_t cdataOffset = sizeof(EngineObject<T>*);
 private:
 	T * cdata;
+	bool ownsStorage;
 public:
-	explicit EngineObject() : cdata(nullptr)
+	explicit EngineObject() : cdata(nullptr), ownsStorage(true)
 	{
 		uintptr_t ptr = reinterpret_cast<uintptr_t>(malloc(cdataOffset + sizeof(T)));
 		EngineObject<T> ** ref = reinterpret_cast<EngineObject<T>**>(ptr);
@@ -79,8 +106,21 @@ public:
 		memset(this->cdata, 0, sizeof(T));
 	}
 
+	// Uses externally allocated memory of at least (cdataOffset + sizeof(T))
+	// bytes for the payload, the memory must outlive the object.
+	explicit EngineObject(void * storage) : cdata(nullptr), ownsStorage(false)
+	{
+		uintptr_t ptr = reinterpret_cast<uintptr_t>(storage);
+		EngineObject<T> ** ref = reinterpret_cast<EngineObject<T>**>(ptr);
+		*ref = this;
+		this->cdata = reinterpret_cast<T*>(ptr + cdataOffset);
+		memset(this->cdata, 0, sizeof(T));
+	}
+
 	virtual ~EngineObject()
 	{
+		if(!this->ownsStorage)
+			return;
 		uintptr_t ptr = reinterpret_cast<uintptr_t>(this->cdata);
 		ptr -= cdataOffset;
 		free(reinterpret_cast<void*>(ptr));
@@ -5,6 +5,9 @@
 #include "collision/collisionsystem.hpp"
 #include "audio/audiomanager.hpp"
 #include "virtfs/resourcemanager.hpp"
+#include "virtfs/resourcecache.hpp"
+#include "core/jobsystem.hpp"
+#include "scene/entitystorage.hpp"
 
 #include <chrono>
 #include <getopt.h>
@@ -129,6 +132,7 @@ ACKNEXT_API_BLOCK
 
 		engine_log("Initialize builtin resources...");
 		ResourceManager::initialize();
+		ResourceCache::initialize();
 
 		if(!(engine_config.flags & CUSTOM_VIDEO))
 		{
@@ -185,6 +189,9 @@ ACKNEXT_API_BLOCK
 		on_resize = event_create();
 		on_shutdown = event_create();
 
+		engine_log("Initialize worker threads...");
+		JobSystem::initialize();
+
 		engine_log("Initialize input...");
 		InputManager::init();
 
@@ -269,6 +276,10 @@ ACKNEXT_API_BLOCK
 
 		event_invoke(on_update, nullptr);
 
+		// Fan out the transform updates, so the collision
+		// sync only has to push the results into ODE.
+		EntityStorage::refreshAll();
+
 		CollisionSystem::update();
 
 		event_invoke(on_late_update, nullptr);
@@ -309,6 +320,12 @@ ACKNEXT_API_BLOCK
 		engine_log("Shutting down collision system...");
 		CollisionSystem::shutdown();
 
+		engine_log("Shutting down worker threads...");
+		JobSystem::shutdown();
+
+		engine_log("Shutting down resource cache...");
+		ResourceCache::shutdown();
+
 		if(!(engine_config.flags & CUSTOM_VIDEO))
 		{
 			engine_log("Destroy GL context.");
@@ -0,0 +1,399 @@
+#include "jobsystem.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Upper bound for helper jobs of a single parallelFor
+#define JOB_MAX_HELPERS 64
+
+struct JOB
+{
+	JOBFUNCTION function;
+	void * context;
+	std::atomic<int> references;
+	std::atomic<int> pending; // unfinished dependencies
+	std::atomic<bool> finished;
+
+	std::mutex lock;
+	std::vector<JOB*> continuations; // guarded by lock
+
+	JOB * nextFree;
+};
+
+// Ring buffer, the owner works at the back, thieves take from the front
+class JobQueue
+{
+private:
+	std::vector<JOB*> ring;
+	size_t head;
+	size_t count;
+public:
+	std::mutex lock;
+public:
+	JobQueue() : ring(256), head(0), count(0) { }
+	NOCOPY(JobQueue);
+
+	void push(JOB * job)
+	{
+		if(this->count == this->ring.size())
+		{
+			std::vector<JOB*> grown(this->ring.size() * 2);
+			for(size_t i = 0; i < this->count; i++)
+				grown[i] = this->ring[(this->head + i) % this->ring.size()];
+			this->ring.swap(grown);
+			this->head = 0;
+		}
+		this->ring[(this->head + this->count) % this->ring.size()] = job;
+		this->count += 1;
+	}
+
+	JOB * popBack()
+	{
+		if(this->count == 0)
+			return nullptr;
+		this->count -= 1;
+		return this->ring[(this->head + this->count) % this->ring.size()];
+	}
+
+	JOB * popFront()
+	{
+		if(this->count == 0)
+			return nullptr;
+		JOB * job = this->ring[this->head];
+		this->head = (this->head + 1) % this->ring.size();
+		this->count -= 1;
+		return job;
+	}
+};
+
+static std::vector<std::thread> threads;
+static std::vector<JobQueue*> queues;
+
+static std::mutex sleepLock;
+static std::condition_variable sleepSignal;
+static std::atomic<int> queued(0);
+static bool terminate = false;
+
+// Threads blocked in JobSystem::wait()
+static std::mutex waitLock;
+static std::condition_variable waitSignal;
+static std::atomic<int> waiters(0);
+
+static std::mutex poolLock;
+static JOB * freeJobs = nullptr;
+
+static thread_local int workerIndex = -1;
+
+static JOB * allocJob()
+{
+	std::lock_guard<std::mutex> _(poolLock);
+	JOB * job = freeJobs;
+	if(job != nullptr) {
+		freeJobs = job->nextFree;
+	} else {
+		job = new JOB;
+	}
+	job->nextFree = nullptr;
+	job->continuations.clear();
+	return job;
+}
+
+static void freeJob(JOB * job)
+{
+	std::lock_guard<std::mutex> _(poolLock);
+	job->nextFree = freeJobs;
+	freeJobs = job;
+}
+
+// Wakes blocked waiters after a job finished or new work was queued
+static void wakeWaiters()
+{
+	if(waiters == 0)
+		return;
+	{ std::lock_guard<std::mutex> _(waitLock); }
+	waitSignal.notify_all();
+}
+
+static void enqueue(JOB * job)
+{
+	JobQueue * queue = queues[std::max(0, workerIndex)];
+	{
+		std::lock_guard<std::mutex> _(queue->lock);
+		queue->push(job);
+	}
+	queued++;
+
+	// Taking the lock makes sure no worker is between
+	// checking `queued` and going to sleep.
+	{ std::lock_guard<std::mutex> _(sleepLock); }
+	sleepSignal.notify_one();
+
+	wakeWaiters();
+}
+
+static JOB * findJob()
+{
+	int self = std::max(0, workerIndex);
+	int count = int(queues.size());
+	for(int i = 0; i < count; i++)
+	{
+		JobQueue * queue = queues[(self + i) % count];
+		std::lock_guard<std::mutex> _(queue->lock);
+		JOB * job = (i == 0) ? queue->popBack() : queue->popFront();
+		if(job != nullptr) {
+			queued--;
+			return job;
+		}
+	}
+	return nullptr;
+}
+
+static void execute(JOB * job)
+{
+	job->function(job->context);
+
+	{
+		std::lock_guard<std::mutex> _(job->lock);
+		job->finished = true;
+		for(JOB * next : job->continuations)
+		{
+			if(--next->pending == 0)
+				enqueue(next);
+		}
+		job->continuations.clear();
+	}
+	wakeWaiters();
+
+	JobSystem::release(job);
+}
+
+static void workerMain(int index)
+{
+	workerIndex = index;
+	while(true)
+	{
+		JOB * job = findJob();
+		if(job != nullptr) {
+			execute(job);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleepLock);
+		sleepSignal.wait(lock, []() { return terminate || (queued > 0); });
+		if(terminate)
+			return;
+	}
+}
+
+void JobSystem::initialize()
+{
+	int count = engine_config.workerThreads;
+	if(count < 0)
+		count = std::max(int(std::thread::hardware_concurrency()) - 1, 0);
+
+	workerIndex = 0;
+	terminate = false;
+
+	queues.push_back(new JobQueue());
+	for(int i = 0; i < count; i++)
+		queues.push_back(new JobQueue());
+
+	threads.reserve(count);
+	for(int i = 0; i < count; i++)
+		threads.emplace_back(workerMain, i + 1);
+
+	engine_log("Using %d worker threads.", count);
+}
+
+void JobSystem::shutdown()
+{
+	// Drain everything left, nobody is allowed to wait on it anymore
+	while(JOB * job = findJob())
+		execute(job);
+
+	{
+		std::lock_guard<std::mutex> _(sleepLock);
+		terminate = true;
+	}
+	sleepSignal.notify_all();
+	for(auto & thread : threads)
+		thread.join();
+	threads.clear();
+
+	for(JobQueue * queue : queues)
+		delete queue;
+	queues.clear();
+
+	while(freeJobs != nullptr)
+	{
+		JOB * job = freeJobs;
+		freeJobs = job->nextFree;
+		delete job;
+	}
+}
+
+int JobSystem::size()
+{
+	return int(threads.size()) + 1;
+}
+
+int JobSystem::currentWorker()
+{
+	return std::max(0, workerIndex);
+}
+
+JOB * JobSystem::submit(JOBFUNCTION function, void * context, JOB * const * dependencies, int count)
+{
+	JOB * job = allocJob();
+	job->function = function;
+	job->context = context;
+	job->references = 2; // caller + execution
+	job->finished = false;
+
+	// Holds the job back until all dependencies are registered
+	job->pending = 1;
+	for(int i = 0; i < count; i++)
+	{
+		JOB * dep = dependencies[i];
+		if(dep == nullptr)
+			continue;
+		std::lock_guard<std::mutex> _(dep->lock);
+		if(!dep->finished) {
+			job->pending++;
+			dep->continuations.push_back(job);
+		}
+	}
+	if(--job->pending == 0)
+		enqueue(job);
+
+	return job;
+}
+
+void JobSystem::wait(JOB * job)
+{
+	while(!job->finished)
+	{
+		JOB * other = findJob();
+		if(other != nullptr) {
+			execute(other);
+			continue;
+		}
+
+		// Nothing to steal, sleep until a job finishes or new work arrives
+		std::unique_lock<std::mutex> lock(waitLock);
+		waiters++;
+		waitSignal.wait(lock, [job]() { return job->finished || (queued > 0); });
+		waiters--;
+	}
+}
+
+bool JobSystem::done(JOB const * job)
+{
+	return job->finished;
+}
+
+void JobSystem::release(JOB * job)
+{
+	if(--job->references == 0)
+		freeJob(job);
+}
+
+struct Range
+{
+	JobSystem::Kernel kernel;
+	void * context;
+	size_t count;
+	size_t grain;
+	std::atomic<size_t> next;
+};
+
+static void processRange(void * context)
+{
+	Range * range = static_cast<Range*>(context);
+	int worker = JobSystem::currentWorker();
+	while(true)
+	{
+		size_t begin = range->next.fetch_add(range->grain);
+		if(begin >= range->count)
+			break;
+		size_t end = std::min(begin + range->grain, range->count);
+		range->kernel(range->context, begin, end, worker);
+	}
+}
+
+void JobSystem::parallelFor(size_t count, size_t grain, Kernel kernel, void * context)
+{
+	if(count == 0)
+		return;
+	if(grain == 0)
+		grain = 1;
+
+	size_t chunks = (count + grain - 1) / grain;
+	size_t helpers = std::min(std::min(chunks - 1, threads.size()), size_t(JOB_MAX_HELPERS));
+
+	Range range;
+	range.kernel = kernel;
+	range.context = context;
+	range.count = count;
+	range.grain = grain;
+	range.next = 0;
+
+	JOB * jobs[JOB_MAX_HELPERS];
+	for(size_t i = 0; i < helpers; i++)
+		jobs[i] = submit(&processRange, &range, nullptr, 0);
+
+	processRange(&range);
+
+	for(size_t i = 0; i < helpers; i++)
+	{
+		wait(jobs[i]);
+		release(jobs[i]);
+	}
+}
+
+ACKNEXT_API_BLOCK
+{
+	JOB * job_submit(JOBFUNCTION function, void * context, JOB * const * dependencies, int dependencyCount)
+	{
+		ARG_NOTNULL(function, nullptr);
+		if(dependencyCount > 0) {
+			ARG_NOTNULL(dependencies, nullptr);
+		}
+		return JobSystem::submit(function, context, dependencies, dependencyCount);
+	}
+
+	void job_wait(JOB * job)
+	{
+		ARG_NOTNULL(job,);
+		JobSystem::wait(job);
+	}
+
+	bool job_done(JOB const * job)
+	{
+		ARG_NOTNULL(job, true);
+		return JobSystem::done(job);
+	}
+
+	void job_remove(JOB * job)
+	{
+		if(job != nullptr)
+			JobSystem::release(job);
+	}
+
+	void job_parallel_for(int count, int grain, JOBRANGEFUNCTION function, void * context)
+	{
+		ARG_NOTNULL(function,);
+		if(count <= 0)
+			return;
+		if(grain <= 0)
+			grain = 1;
+		JobSystem::parallelFor(size_t(count), size_t(grain), [=](size_t begin, size_t end, int)
+		{
+			function(context, int(begin), int(end));
+		});
+	}
+}
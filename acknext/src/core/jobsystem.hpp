@@ -0,0 +1,54 @@
+#ifndef JOBSYSTEM_HPP
+#define JOBSYSTEM_HPP
+
+#include <engine.hpp>
+
+// Work-stealing job system. Every worker owns a queue, new jobs go
+// into the queue of the submitting thread and idle workers steal
+// from the others. The main thread counts as worker 0 and helps
+// executing jobs while waiting.
+class JobSystem
+{
+public:
+	typedef void (*Kernel)(void * context, size_t begin, size_t end, int worker);
+public:
+	JobSystem() = delete;
+
+	static void initialize();
+
+	static void shutdown();
+
+	// Number of threads that may execute jobs, including the main thread
+	static int size();
+
+	// 0 for the main thread, 1 … size()-1 for the workers
+	static int currentWorker();
+
+	static JOB * submit(JOBFUNCTION function, void * context, JOB * const * dependencies, int count);
+
+	static void wait(JOB * job);
+
+	static bool done(JOB const * job);
+
+	static void release(JOB * job);
+
+	// Splits [0,count) into chunks of `grain` elements and processes
+	// them on all workers plus the calling thread.
+	static void parallelFor(size_t count, size_t grain, Kernel kernel, void * context);
+
+	// Calls fn(begin, end, worker) for each chunk without allocating
+	template<typename F>
+	static void parallelFor(size_t count, size_t grain, F const & fn)
+	{
+		parallelFor(count, grain, &JobSystem::invoke<F>, const_cast<void*>(static_cast<void const*>(&fn)));
+	}
+
+private:
+	template<typename F>
+	static void invoke(void * context, size_t begin, size_t end, int worker)
+	{
+		(*static_cast<F const *>(context))(begin, end, worker);
+	}
+};
+
+#endif // JOBSYSTEM_HPP
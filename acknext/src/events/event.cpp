@@ -3,7 +3,8 @@
 Event::Event(bool isUserDefined) :
     EngineObject<EVENT>(),
     userDefined(isUserDefined),
-    handlers()
+    handlers(),
+    contextHandlers()
 {
 
 }
@@ -11,6 +12,7 @@ Event::Event(bool isUserDefined) :
 void Event::clear()
 {
 	this->handlers.clear();
+	this->contextHandlers.clear();
 }
 
 void Event::attach(EVENTHANDLER ptr)
@@ -26,11 +28,24 @@ void Event::detach(EVENTHANDLER ptr)
 	}
 }
 
+void Event::attach(EVENTHANDLEREXT ptr, void * context)
+{
+	this->contextHandlers.emplace(ptr, context);
+}
+
+void Event::detach(EVENTHANDLEREXT ptr, void * context)
+{
+	this->contextHandlers.erase(std::make_pair(ptr, context));
+}
+
 void Event::invoke(void * arg)
 {
 	for(EVENTHANDLER const & ev : this->handlers) {
 		ev(arg);
 	}
+	for(auto const & ev : this->contextHandlers) {
+		ev.first(ev.second, arg);
+	}
 }
 
 ACKNEXT_API_BLOCK
@@ -56,6 +71,22 @@ ACKNEXT_API_BLOCK
 		}
 	}
 
+	void event_attachExt(EVENT * _ev, EVENTHANDLEREXT handler, void * context)
+	{
+		Event * ev = promote<Event>(_ev);
+		if(ev && handler) {
+			ev->attach(handler, context);
+		}
+	}
+
+	void event_detachExt(EVENT * _ev, EVENTHANDLEREXT handler, void * context)
+	{
+		Event * ev = promote<Event>(_ev);
+		if(ev && handler) {
+			ev->detach(handler, context);
+		}
+	}
+
 	void event_clear(EVENT * _ev)
 	{
 		Event * ev = promote<Event>(_ev);
@@ -4,6 +4,7 @@
 #include <engine.hpp>
 #include <stdarg.h>
 #include <set>
+#include <utility>
 
 class Event : public EngineObject<EVENT>
 {
@@ -11,6 +12,7 @@ public:
 	const bool userDefined;
 private:
 	std::set<EVENTHANDLER> handlers;
+	std::set<std::pair<EVENTHANDLEREXT, void*>> contextHandlers;
 public:
 	explicit Event(bool isUserDefined = false);
 	NOCOPY(Event);
@@ -19,9 +21,11 @@ public:
 	void clear();
 	void attach(EVENTHANDLER ptr);
 	void detach(EVENTHANDLER ptr);
+	void attach(EVENTHANDLEREXT ptr, void * context);
+	void detach(EVENTHANDLEREXT ptr, void * context);
 
 	bool isEmpty() const {
-		return this->handlers.empty();
+		return this->handlers.empty() && this->contextHandlers.empty();
 	}
 
 	void invoke(void * arg);
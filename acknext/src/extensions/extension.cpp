@@ -4,6 +4,8 @@
 #include <acknext/serialization.h>
 #include <acknext/acff.h>
 
+#include "../virtfs/resourcecache.hpp"
+
 std::list<Extension> Extension::extensions;
 
 Extension::Extension(std::string const & name, EXTENSION * ext) :
@@ -37,7 +39,16 @@ void * Extension::load(ACKFILE * file, ACKTYPE refType)
 		bool allowCaching  = file_read_uint8(file);
 		char * subfileName = file_read_string(file, 0);
 
+		allowCaching = allowCaching && ResourceCache::supports(refType);
+
 		void * object = nullptr;
+		if(allowCaching) {
+			object = ResourceCache::acquire(refType, subfileName);
+			if(object != nullptr) {
+				free(subfileName);
+				return object;
+			}
+		}
 
 		ACKFILE * subfile = file_open_read(subfileName);
 		engine_log("Loading symlink: %s ^ %d → %p",
@@ -45,7 +56,13 @@ void * Extension::load(ACKFILE * file, ACKTYPE refType)
 			allowCaching,
 		    subfile);
 		if(subfile) {
+			int64_t size = file_size(subfile);
+			size_t bytes = (size > 0) ? size_t(size) : 0;
 			object = Extension::load(subfile, refType);
+			file_close(subfile);
+			if(object != nullptr && allowCaching) {
+				ResourceCache::insert(refType, subfileName, object, bytes);
+			}
 		} else {
 			engine_seterror(ERR_INVALIDARGUMENT, "Could not load referenced file '%s'.", subfileName);
 		}
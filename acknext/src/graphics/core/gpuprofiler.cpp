@@ -0,0 +1,173 @@
+#include "gpuprofiler.hpp"
+#include <vector>
+
+// Number of frames the GPU may lag behind before frames stay unmeasured
+#define QUERY_FRAMES 4
+
+struct Timer
+{
+	GpuProfiler::Scope scope;
+	GLuint begin, end;
+};
+
+struct QueryFrame
+{
+	std::vector<GLuint> timestamps; // grows on demand, reused
+	size_t used = 0;
+	std::vector<Timer> timers;
+	GLuint primitives = 0;
+	uint64_t frame = 0;
+	bool pending = false;
+
+	GLuint acquire()
+	{
+		if(this->used >= this->timestamps.size()) {
+			GLuint query;
+			glCreateQueries(GL_TIMESTAMP, 1, &query);
+			this->timestamps.push_back(query);
+		}
+		return this->timestamps[this->used++];
+	}
+
+	bool available() const
+	{
+		// The first timer is the frame, its end is the last query
+		GLuint ready = GL_TRUE;
+		if(this->timers.size() > 0)
+			glGetQueryObjectuiv(this->timers[0].end, GL_QUERY_RESULT_AVAILABLE, &ready);
+		if(ready == GL_FALSE)
+			return false;
+		glGetQueryObjectuiv(this->primitives, GL_QUERY_RESULT_AVAILABLE, &ready);
+		return (ready != GL_FALSE);
+	}
+};
+
+static QueryFrame frames[QUERY_FRAMES];
+static int current = 0;
+static QueryFrame * recording = nullptr;
+static int opened[GpuProfiler::ScopeCount];
+static int depth[GpuProfiler::ScopeCount];
+static uint64_t frameCounter = 0;
+static bool useTimers = false;
+
+static void collect(QueryFrame & f)
+{
+	double times[GpuProfiler::ScopeCount] = { 0 };
+	for(Timer const & timer : f.timers)
+	{
+		GLuint64 begin, end;
+		glGetQueryObjectui64v(timer.begin, GL_QUERY_RESULT, &begin);
+		glGetQueryObjectui64v(timer.end, GL_QUERY_RESULT, &end);
+		times[timer.scope] += (end - begin) / 1000000.0;
+	}
+
+	GLuint64 count;
+	glGetQueryObjectui64v(f.primitives, GL_QUERY_RESULT, &count);
+
+	engine_stats.polygons = count;
+	engine_stats.gpuTime = times[GpuProfiler::Frame];
+	engine_stats.gpuScene = times[GpuProfiler::Scene];
+	engine_stats.gpuSSAO = times[GpuProfiler::SSAO];
+	engine_stats.gpuBloom = times[GpuProfiler::Bloom];
+	engine_stats.gpuTonemap = times[GpuProfiler::Tonemap];
+	engine_stats.gpuFXAA = times[GpuProfiler::FXAA];
+	engine_stats.gpuDebug = times[GpuProfiler::Debug];
+	engine_stats.gpuLatency = int(frameCounter - f.frame);
+
+	f.pending = false;
+}
+
+void GpuProfiler::initialize()
+{
+	int bits;
+	glGetQueryiv(GL_TIMESTAMP, GL_QUERY_COUNTER_BITS, &bits);
+	engine_log("Query Resolution: %d", bits);
+	useTimers = (bits > 0);
+
+	for(QueryFrame & f : frames)
+		glCreateQueries(GL_PRIMITIVES_GENERATED, 1, &f.primitives);
+}
+
+void GpuProfiler::shutdown()
+{
+	for(QueryFrame & f : frames)
+	{
+		if(f.timestamps.size() > 0)
+			glDeleteQueries(f.timestamps.size(), f.timestamps.data());
+		glDeleteQueries(1, &f.primitives);
+		f = QueryFrame();
+	}
+	recording = nullptr;
+}
+
+void GpuProfiler::beginFrame()
+{
+	frameCounter += 1;
+	for(int & d : depth)
+		d = 0;
+
+	QueryFrame & f = frames[current];
+	if(f.pending)
+	{
+		// GPU is more than QUERY_FRAMES behind, don't wait for it
+		if(f.available() == false) {
+			recording = nullptr;
+			return;
+		}
+		collect(f);
+	}
+
+	f.used = 0;
+	f.timers.clear();
+	f.frame = frameCounter;
+	recording = &f;
+
+	glBeginQuery(GL_PRIMITIVES_GENERATED, f.primitives);
+	begin(Frame);
+}
+
+void GpuProfiler::endFrame()
+{
+	if(recording != nullptr)
+	{
+		end(Frame);
+		glEndQuery(GL_PRIMITIVES_GENERATED);
+		recording->pending = true;
+		recording = nullptr;
+		current = (current + 1) % QUERY_FRAMES;
+	}
+
+	// Results arrive in order, so stop at the first unfinished frame
+	for(int i = 0; i < QUERY_FRAMES; i++)
+	{
+		QueryFrame & f = frames[(current + i) % QUERY_FRAMES];
+		if(f.pending == false)
+			continue;
+		if(f.available() == false)
+			break;
+		collect(f);
+	}
+}
+
+void GpuProfiler::begin(Scope scope)
+{
+	if(depth[scope]++ > 0 || recording == nullptr || useTimers == false)
+		return;
+	Timer timer;
+	timer.scope = scope;
+	timer.begin = recording->acquire();
+	timer.end = 0;
+	glQueryCounter(timer.begin, GL_TIMESTAMP);
+	opened[scope] = recording->timers.size();
+	recording->timers.push_back(timer);
+}
+
+void GpuProfiler::end(Scope scope)
+{
+	assert(depth[scope] > 0);
+	if(--depth[scope] > 0 || recording == nullptr || useTimers == false)
+		return;
+	Timer & timer = recording->timers[opened[scope]];
+	timer.end = recording->acquire();
+	glQueryCounter(timer.end, GL_TIMESTAMP);
+}
@@ -0,0 +1,43 @@
+#ifndef GPUPROFILER_HPP
+#define GPUPROFILER_HPP
+
+#include <engine.hpp>
+
+// Measures the GPU time of the render scopes with timestamp queries.
+// The queries of the last frames are kept in a ring and only read when
+// their results are available, so engine_stats lags a few frames behind
+// but the CPU never waits for the GPU.
+class GpuProfiler
+{
+public:
+	enum Scope
+	{
+		Frame,
+		Scene,
+		SSAO,
+		Bloom,
+		Tonemap,
+		FXAA,
+		Debug,
+		ScopeCount
+	};
+public:
+	GpuProfiler() = delete;
+
+	static void initialize();
+
+	static void shutdown();
+
+	static void beginFrame();
+
+	// Copies all available results into engine_stats
+	static void endFrame();
+
+	// Scopes may nest and may be entered multiple times per frame,
+	// their times are summed up.
+	static void begin(Scope scope);
+
+	static void end(Scope scope);
+};
+
+#endif // GPUPROFILER_HPP
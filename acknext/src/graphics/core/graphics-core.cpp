@@ -1,11 +1,13 @@
 #include "graphics/core.hpp"
 #include "view.hpp"
+#include "gpuprofiler.hpp"
 #include <engine.hpp>
 #include <algorithm>
 
 #include "../opengl/shader.hpp"
 #include "../opengl/buffer.hpp"
 #include "../opengl/bitmap.hpp"
+#include "../opengl/glstate.hpp"
 #include "../scene/camera.hpp"
 
 #include "../debug/debugdrawer.hpp"
@@ -36,63 +38,6 @@ ACKNEXT_API_BLOCK
 	VIEW * view_current;
 }
 
-struct drawquery
-{
-	GLuint renderTimeQuery, primitiveQuery;
-
-	drawquery()
-	{
-		glCreateQueries(GL_TIME_ELAPSED, 1, &renderTimeQuery);
-		glCreateQueries(GL_PRIMITIVES_GENERATED, 1, &primitiveQuery);
-	}
-
-	~drawquery()
-	{
-
-	}
-
-	void begin()
-	{
-		glBeginQuery(GL_TIME_ELAPSED, renderTimeQuery);
-		glBeginQuery(GL_PRIMITIVES_GENERATED, primitiveQuery);
-	}
-
-	void end()
-	{
-		glEndQuery(GL_PRIMITIVES_GENERATED);
-		glEndQuery(GL_TIME_ELAPSED);
-	}
-
-	void copyTo(ENGINESTATS & stats)
-	{
-		ulong time;
-		glGetQueryObjectui64v(renderTimeQuery, GL_QUERY_RESULT, &time);
-		stats.gpuTime = time / 1000000.0;
-
-		ulong count;
-		glGetQueryObjectui64v(primitiveQuery, GL_QUERY_RESULT, &count);
-		stats.polygons = count;
-	}
-};
-
-static drawquery & getQuery()
-{
-	static std::vector<drawquery> queries;
-	static uint nextQuery = 0;
-	if(queries.size() == 0)
-	{
-		// Create two queries
-		queries.emplace_back();
-		queries.emplace_back();
-	}
-
-	drawquery & q = queries[nextQuery];
-	nextQuery += 1;
-	if(nextQuery >= queries.size())
-		nextQuery = 0;
-	return q;
-}
-
 static void (APIENTRY render_log)(GLenum source,GLenum type,GLuint id,GLenum severity,GLsizei length,const GLchar *message,const void *userParam);
 
 void render_init()
@@ -123,6 +68,7 @@ void render_init()
 	glEnableVertexArrayAttrib(vao, 9);
 	glEnableVertexArrayAttrib(vao, 10);
 	glEnableVertexArrayAttrib(vao, 11);
+	glEnableVertexArrayAttrib(vao, 12);
 
 	glVertexArrayAttribFormat(vao,
 		0, // position
@@ -198,6 +144,11 @@ void render_init()
 		GL_FLOAT,
 		GL_FALSE,
 		48);
+	glVertexArrayAttribIFormat(vao,
+		12, // instancing bone palette offset, int in object.vert
+		1,
+		GL_INT,
+		64);
 
 	glVertexArrayAttribBinding(vao,  0, 10);
 	glVertexArrayAttribBinding(vao,  1, 10);
@@ -212,6 +163,7 @@ void render_init()
 	glVertexArrayAttribBinding(vao,  9, 12);
 	glVertexArrayAttribBinding(vao, 10, 12);
 	glVertexArrayAttribBinding(vao, 11, 12);
+	glVertexArrayAttribBinding(vao, 12, 12);
 
 	glBindVertexArray(vao);
 
@@ -257,12 +209,7 @@ void render_init()
 	camera = camera_create();
 	promote<Camera>(::camera)->userCreated = false;
 
-	{
-		int num;
-		glGetQueryiv(GL_TIME_ELAPSED, GL_QUERY_COUNTER_BITS, &num);
-		engine_log("Query Resolution: %d", num);
-
-	}
+	GpuProfiler::initialize();
 
 	noisemap = bmap_load("/builtin/textures/noise.atx");
 
@@ -317,28 +264,33 @@ void render_init()
 	}
 
 	DebugDrawer::initialize();
+
+	GLState::reset();
 }
 
 void render_frame()
 {
 	engine_stats.drawcalls = 0;
-	engine_stats.gpuTime = 0.0;
+	engine_stats.stateChanges = 0;
+	engine_stats.stateChangesAvoided = 0;
+
+	// Anything may have touched GL since the last frame
+	GLState::reset();
+	GLState::resetCounters();
 
 	std::sort(
 		View::all.begin(),
 		View::all.end(),
 		[](View * lhs, View * rhs) { return (lhs->api().layer < rhs->api().layer); });
 
-	drawquery & query = getQuery();
-
-	query.begin();
+	GpuProfiler::beginFrame();
 
-	glDisable(GL_SCISSOR_TEST);
+	GLState::enable(GL_SCISSOR_TEST, false);
 
 	glClearColor(screen_color.red, screen_color.green, screen_color.blue, screen_color.alpha);
 	glClear(GL_COLOR_BUFFER_BIT);
 
-	glEnable(GL_SCISSOR_TEST);
+	GLState::enable(GL_SCISSOR_TEST, true);
 
 	for(View * view : View::all)
 	{
@@ -347,19 +299,21 @@ void render_frame()
 		view_current = nullptr;
 	}
 
-	query.end();
+	GpuProfiler::endFrame();
+
+	engine_stats.glCalls = GLState::issued();
+	engine_stats.glCallsElided = GLState::elided();
 
 	SDL_GL_SwapWindow(engine.window);
-	glDisable(GL_SCISSOR_TEST);
+	GLState::enable(GL_SCISSOR_TEST, false);
 
 	DebugDrawer::reset();
-
-	query.copyTo(engine_stats);
 }
 
 void render_shutdown()
 {
 	DebugDrawer::shutdown();
+	GpuProfiler::shutdown();
 }
 
 static void (APIENTRY render_log)(GLenum source,GLenum type,GLuint id,GLenum severity,GLsizei length,const GLchar *message,const void *userParam)
@@ -1,4 +1,5 @@
 #include "view.hpp"
+#include "../opengl/glstate.hpp"
 #include <algorithm>
 
 std::vector<View*> View::all;
@@ -39,10 +40,13 @@ void View::draw()
 
 	int gly = screen_size.height - pos.y - size.height;
 
-	glViewport(pos.x, gly, size.width, size.height);
-	glScissor(pos.x, gly, size.width, size.height);
+	GLState::viewport(pos.x, gly, size.width, size.height);
+	GLState::scissor(pos.x, gly, size.width, size.height);
 
 	view.renderer(view.context);
+
+	// Renderers may use GL directly
+	GLState::reset();
 }
 
 ACKNEXT_API_BLOCK
@@ -1,4 +1,5 @@
 #include "debugdrawer.hpp"
+#include "../opengl/glstate.hpp"
 
 std::vector<VERTEX> DebugDrawer::lines;
 std::vector<VERTEX> DebugDrawer::points;
@@ -31,7 +32,7 @@ void DebugDrawer::render(MATRIX const & matView, MATRIX const & matProj)
 		&matProj);
 
 	glDepthFunc(GL_LEQUAL);
-	glDisable(GL_BLEND);
+	GLState::enable(GL_BLEND, false);
 
 	if(points.size() > 0)
 	{
@@ -1,9 +1,11 @@
 #include "bitmap.hpp"
+#include "glstate.hpp"
 
 #include <assert.h>
 #include <SDL2/SDL_image.h>
 
 #include "extensions/extension.hpp"
+#include "virtfs/resourcecache.hpp"
 #include <acknext/serialization.h>
 
 Bitmap::Bitmap(GLenum type, GLenum format)
@@ -19,9 +21,19 @@ Bitmap::~Bitmap()
 	if(api().pixels) {
 		free(api().pixels);
 	}
+	GLState::forgetTexture(api().object);
 	glDeleteTextures(1, &api().object);
 }
 
+static BITMAP * cacheBitmap(char const * fileName, BITMAP * bmp)
+{
+	if(bmp != nullptr) {
+		size_t depth = (bmp->depth > 1) ? size_t(bmp->depth) : 1;
+		ResourceCache::insert(TYPE_BITMAP, fileName, bmp, 4 * size_t(bmp->width) * size_t(bmp->height) * depth);
+	}
+	return bmp;
+}
+
 ACKNEXT_API_BLOCK
 {
 	// for loading bitmaps
@@ -57,6 +69,8 @@ ACKNEXT_API_BLOCK
 
 	BITMAP * bmap_load(char const * fileName)
 	{
+		ARG_NOTNULL(fileName, nullptr);
+
 		ACKFILE * file = file_open_read(fileName);
 		if(file == nullptr) {
 			return nullptr;
@@ -116,6 +130,17 @@ ACKNEXT_API_BLOCK
 		return bmp;
 	}
 
+	BITMAP * bmap_get(char const * fileName)
+	{
+		ARG_NOTNULL(fileName, nullptr);
+
+		BITMAP * cached = (BITMAP*)ResourceCache::acquire(TYPE_BITMAP, fileName);
+		if(cached != nullptr) {
+			return cached;
+		}
+		return cacheBitmap(fileName, bmap_load(fileName));
+	}
+
 	void bmap_renew(BITMAP * bitmap)
 	{
 		ARG_NOTNULL(bitmap,);
@@ -123,6 +148,7 @@ ACKNEXT_API_BLOCK
 		if(bitmap->pixels)
 			free(bitmap->pixels);
 
+		GLState::forgetTexture(bitmap->object);
 		glDeleteTextures(1, &bitmap->object);
 		glCreateTextures(bitmap->target, 1, &bitmap->object);
 
@@ -214,6 +240,9 @@ ACKNEXT_API_BLOCK
 
 	void bmap_remove(BITMAP * bitmap)
 	{
+		if(ResourceCache::release(bitmap)) {
+			return;
+		}
 		Bitmap * bmp = promote<Bitmap>(bitmap);
 		if(bmp) {
 			delete bmp;
@@ -1,4 +1,5 @@
 #include "buffer.hpp"
+#include "glstate.hpp"
 
 Buffer::Buffer(GLenum type) :
     EngineObject<BUFFER>()
@@ -10,6 +11,7 @@ Buffer::Buffer(GLenum type) :
 
 Buffer::~Buffer()
 {
+	GLState::forgetBuffer(this->api().object);
 	glDeleteBuffers(1, &this->api().object);
 }
 
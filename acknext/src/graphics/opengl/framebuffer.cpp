@@ -1,6 +1,7 @@
 #include "framebuffer.hpp"
 
 #include "../core/glenum-translator.hpp"
+#include "glstate.hpp"
 
 FrameBuffer::FrameBuffer()
 {
@@ -9,6 +10,7 @@ FrameBuffer::FrameBuffer()
 
 FrameBuffer::~FrameBuffer()
 {
+	GLState::forgetFramebuffer(api().object);
 	glDeleteFramebuffers(1, &api().object);
 }
 
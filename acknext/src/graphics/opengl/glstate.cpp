@@ -0,0 +1,285 @@
+#include "glstate.hpp"
+
+#include <string.h>
+
+#define UNKNOWN GLuint(-1)
+#define TEXTURE_UNITS 32
+#define UNIFORM_BINDINGS 16
+#define VERTEX_BINDINGS 16
+
+enum Capability
+{
+	CullFace,
+	DepthTest,
+	Blend,
+	ScissorTest,
+	CapabilityCount
+};
+
+struct VertexArrayState
+{
+	GLuint vao;
+	GLuint elements;
+	GLuint buffers[VERTEX_BINDINGS];
+	GLintptr offsets[VERTEX_BINDINGS];
+	GLsizei strides[VERTEX_BINDINGS];
+};
+
+static struct
+{
+	GLuint program;
+	GLuint framebuffer;
+	GLint viewport[4];
+	GLint scissor[4];
+	bool viewportValid;
+	bool scissorValid;
+	int caps[CapabilityCount]; // -1 is unknown
+	GLenum polygonMode;
+	GLuint textures[TEXTURE_UNITS];
+	GLuint uniformBuffers[UNIFORM_BINDINGS];
+	GLuint vao;
+	VertexArrayState arrays[4]; // small cache of recently used VAOs
+	int nextArray;
+} state;
+
+static int callsIssued = 0;
+static int callsElided = 0;
+
+static int capability(GLenum cap)
+{
+	switch(cap)
+	{
+		case GL_CULL_FACE: return CullFace;
+		case GL_DEPTH_TEST: return DepthTest;
+		case GL_BLEND: return Blend;
+		case GL_SCISSOR_TEST: return ScissorTest;
+		default: return -1;
+	}
+}
+
+static void forgetArray(VertexArrayState & array)
+{
+	array.vao = UNKNOWN;
+	array.elements = UNKNOWN;
+	for(int i = 0; i < VERTEX_BINDINGS; i++)
+		array.buffers[i] = UNKNOWN;
+}
+
+static VertexArrayState & arrayState(GLuint vao)
+{
+	for(VertexArrayState & array : state.arrays)
+	{
+		if(array.vao == vao)
+			return array;
+	}
+	VertexArrayState & array = state.arrays[state.nextArray];
+	state.nextArray = (state.nextArray + 1) % 4;
+	forgetArray(array);
+	array.vao = vao;
+	return array;
+}
+
+void GLState::reset()
+{
+	state.program = UNKNOWN;
+	state.framebuffer = UNKNOWN;
+	state.viewportValid = false;
+	state.scissorValid = false;
+	for(int & cap : state.caps)
+		cap = -1;
+	state.polygonMode = GL_NONE;
+	for(GLuint & texture : state.textures)
+		texture = UNKNOWN;
+	for(GLuint & buffer : state.uniformBuffers)
+		buffer = UNKNOWN;
+	state.vao = UNKNOWN;
+	for(VertexArrayState & array : state.arrays)
+		forgetArray(array);
+	state.nextArray = 0;
+}
+
+void GLState::resetCounters()
+{
+	callsIssued = 0;
+	callsElided = 0;
+}
+
+int GLState::issued()
+{
+	return callsIssued;
+}
+
+int GLState::elided()
+{
+	return callsElided;
+}
+
+bool GLState::update(bool changed)
+{
+	if(changed)
+		callsIssued += 1;
+	else
+		callsElided += 1;
+	return changed;
+}
+
+void GLState::useProgram(GLuint program)
+{
+	if(update(state.program != program)) {
+		glUseProgram(program);
+		state.program = program;
+	}
+}
+
+void GLState::bindDrawFramebuffer(GLuint framebuffer)
+{
+	if(update(state.framebuffer != framebuffer)) {
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+		state.framebuffer = framebuffer;
+	}
+}
+
+void GLState::viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	GLint const v[4] = { x, y, width, height };
+	if(update(!state.viewportValid || memcmp(state.viewport, v, sizeof(v)) != 0)) {
+		glViewport(x, y, width, height);
+		memcpy(state.viewport, v, sizeof(v));
+		state.viewportValid = true;
+	}
+}
+
+void GLState::scissor(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	GLint const v[4] = { x, y, width, height };
+	if(update(!state.scissorValid || memcmp(state.scissor, v, sizeof(v)) != 0)) {
+		glScissor(x, y, width, height);
+		memcpy(state.scissor, v, sizeof(v));
+		state.scissorValid = true;
+	}
+}
+
+void GLState::enable(GLenum cap, bool enabled)
+{
+	int index = capability(cap);
+	bool changed = (index < 0) || (state.caps[index] != int(enabled));
+	if(update(changed)) {
+		if(enabled)
+			glEnable(cap);
+		else
+			glDisable(cap);
+		if(index >= 0)
+			state.caps[index] = enabled;
+	}
+}
+
+void GLState::polygonMode(GLenum mode)
+{
+	if(update(state.polygonMode != mode)) {
+		glPolygonMode(GL_FRONT_AND_BACK, mode);
+		state.polygonMode = mode;
+	}
+}
+
+void GLState::bindTexture(GLuint unit, GLuint texture)
+{
+	if(unit >= TEXTURE_UNITS) {
+		update(true);
+		glBindTextureUnit(unit, texture);
+		return;
+	}
+	if(update(state.textures[unit] != texture)) {
+		glBindTextureUnit(unit, texture);
+		state.textures[unit] = texture;
+	}
+}
+
+void GLState::bindUniformBuffer(GLuint index, GLuint buffer)
+{
+	if(index >= UNIFORM_BINDINGS) {
+		update(true);
+		glBindBufferBase(GL_UNIFORM_BUFFER, index, buffer);
+		return;
+	}
+	if(update(state.uniformBuffers[index] != buffer)) {
+		glBindBufferBase(GL_UNIFORM_BUFFER, index, buffer);
+		state.uniformBuffers[index] = buffer;
+	}
+}
+
+void GLState::bindVertexArray(GLuint vao)
+{
+	if(update(state.vao != vao)) {
+		glBindVertexArray(vao);
+		state.vao = vao;
+	}
+}
+
+void GLState::vertexBuffer(GLuint vao, GLuint binding, GLuint buffer, GLintptr offset, GLsizei stride)
+{
+	if(binding >= VERTEX_BINDINGS) {
+		update(true);
+		glVertexArrayVertexBuffer(vao, binding, buffer, offset, stride);
+		return;
+	}
+	VertexArrayState & array = arrayState(vao);
+	bool changed =
+		   array.buffers[binding] != buffer
+		|| array.offsets[binding] != offset
+		|| array.strides[binding] != stride;
+	if(update(changed)) {
+		glVertexArrayVertexBuffer(vao, binding, buffer, offset, stride);
+		array.buffers[binding] = buffer;
+		array.offsets[binding] = offset;
+		array.strides[binding] = stride;
+	}
+}
+
+void GLState::elementBuffer(GLuint vao, GLuint buffer)
+{
+	VertexArrayState & array = arrayState(vao);
+	if(update(array.elements != buffer)) {
+		glVertexArrayElementBuffer(vao, buffer);
+		array.elements = buffer;
+	}
+}
+
+void GLState::forgetProgram(GLuint program)
+{
+	if(state.program == program)
+		state.program = UNKNOWN;
+}
+
+void GLState::forgetFramebuffer(GLuint framebuffer)
+{
+	if(state.framebuffer == framebuffer)
+		state.framebuffer = UNKNOWN;
+}
+
+void GLState::forgetTexture(GLuint texture)
+{
+	for(GLuint & bound : state.textures)
+	{
+		if(bound == texture)
+			bound = UNKNOWN;
+	}
+}
+
+void GLState::forgetBuffer(GLuint buffer)
+{
+	for(GLuint & bound : state.uniformBuffers)
+	{
+		if(bound == buffer)
+			bound = UNKNOWN;
+	}
+	for(VertexArrayState & array : state.arrays)
+	{
+		if(array.elements == buffer)
+			array.elements = UNKNOWN;
+		for(GLuint & bound : array.buffers)
+		{
+			if(bound == buffer)
+				bound = UNKNOWN;
+		}
+	}
+}
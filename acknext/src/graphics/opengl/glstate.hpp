@@ -0,0 +1,60 @@
+#ifndef GLSTATE_HPP
+#define GLSTATE_HPP
+
+#include <engine.hpp>
+
+// Shadow copy of the GL state the engine changes. Calls that would
+// not change anything are skipped and counted as elided. Everything
+// that touches GL directly must call reset() afterwards, deleted
+// objects must be forgotten so their names can be reused.
+class GLState
+{
+public:
+	GLState() = delete;
+
+	// Forgets all state, the next calls are issued again
+	static void reset();
+
+	static void resetCounters();
+
+	static int issued();
+
+	static int elided();
+
+	// Counts a call, returns true when it has to be issued
+	static bool update(bool changed);
+
+	static void useProgram(GLuint program);
+
+	static void bindDrawFramebuffer(GLuint framebuffer);
+
+	static void viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+
+	static void scissor(GLint x, GLint y, GLsizei width, GLsizei height);
+
+	// GL_CULL_FACE, GL_DEPTH_TEST, GL_BLEND and GL_SCISSOR_TEST
+	// are tracked, everything else is passed through
+	static void enable(GLenum cap, bool enabled);
+
+	static void polygonMode(GLenum mode);
+
+	static void bindTexture(GLuint unit, GLuint texture);
+
+	static void bindUniformBuffer(GLuint index, GLuint buffer);
+
+	static void bindVertexArray(GLuint vao);
+
+	static void vertexBuffer(GLuint vao, GLuint binding, GLuint buffer, GLintptr offset, GLsizei stride);
+
+	static void elementBuffer(GLuint vao, GLuint buffer);
+
+	static void forgetProgram(GLuint program);
+
+	static void forgetFramebuffer(GLuint framebuffer);
+
+	static void forgetTexture(GLuint texture);
+
+	static void forgetBuffer(GLuint buffer);
+};
+
+#endif // GLSTATE_HPP
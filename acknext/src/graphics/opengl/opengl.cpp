@@ -3,6 +3,7 @@
 #include "buffer.hpp"
 #include "shader.hpp"
 #include "bitmap.hpp"
+#include "glstate.hpp"
 
 #include "../shareddata.hpp"
 
@@ -29,18 +30,16 @@ ACKNEXT_API_BLOCK
 		}
 
 		currentFramebuffer = fb;
-		glBindFramebuffer(
-			GL_DRAW_FRAMEBUFFER,
-			(fb != nullptr) ? fb->object : 0);
+		GLState::bindDrawFramebuffer((fb != nullptr) ? fb->object : 0);
 
 		if(fb)
 		{
-			glDisable(GL_SCISSOR_TEST);
-			glViewport(0, 0, fb->size.width, fb->size.height);
+			GLState::enable(GL_SCISSOR_TEST, false);
+			GLState::viewport(0, 0, fb->size.width, fb->size.height);
 		}
 		else
 		{
-			glEnable(GL_SCISSOR_TEST);
+			GLState::enable(GL_SCISSOR_TEST, true);
 
 			POINT pos;
 			SIZE size;
@@ -52,8 +51,8 @@ ACKNEXT_API_BLOCK
 
 			int gly = screen_size.height - pos.y - size.height;
 
-			glViewport(pos.x, gly, size.width, size.height);
-			glScissor(pos.x, gly, size.width, size.height);
+			GLState::viewport(pos.x, gly, size.width, size.height);
+			GLState::scissor(pos.x, gly, size.width, size.height);
 		}
 	}
 
@@ -73,7 +72,7 @@ ACKNEXT_API_BLOCK
 			id = buffer->api().object;
 		}
 
-		glVertexArrayVertexBuffer(
+		GLState::vertexBuffer(
 			vao, 10,
 		    id, 0, sizeof(VERTEX));
 
@@ -96,7 +95,7 @@ ACKNEXT_API_BLOCK
 			id = buffer->api().object;
 		}
 
-		glVertexArrayElementBuffer(vao, id);
+		GLState::elementBuffer(vao, id);
 
 		currentIndexBuffer = buffer;
 	}
@@ -221,7 +220,7 @@ ACKNEXT_API_BLOCK
 		}
 
 		currentShader = FALLBACK(const_cast<Shader*>(promote<Shader>(shader)), defaultShader);
-		glUseProgram(currentShader->api().object);
+		GLState::useProgram(currentShader->api().object);
 
 		POINT pos;
 		SIZE size;
@@ -237,7 +236,7 @@ ACKNEXT_API_BLOCK
 	void opengl_setTexture(int slot, BITMAP const * _texture)
 	{
 		Bitmap const * texture = promote<Bitmap>(FALLBACK(_texture, defaultWhiteTexture));
-		glBindTextureUnit(slot, texture->api().object);
+		GLState::bindTexture(slot, texture->api().object);
 	}
 
 	GLenum opengl_setMesh(MESH const * mesh, int * _count)
@@ -293,9 +292,14 @@ ACKNEXT_API_BLOCK
 			1);
 	}
 
+	void opengl_resetState()
+	{
+		GLState::reset();
+	}
+
 	void opengl_drawFullscreenQuad()
 	{
-		glBindVertexArray(vao);
+		GLState::bindVertexArray(vao);
 		currentShader->useInstancing = false;
 		currentShader->useBones = false;
 		opengl_setVertexBuffer(fullscreenQuadBuffer);
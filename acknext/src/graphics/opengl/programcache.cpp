@@ -0,0 +1,134 @@
+#include "programcache.hpp"
+
+#include <physfs.h>
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+
+#define CACHE_DIR "shadercache"
+#define CACHE_MAGIC 0x4E494250 // "PBIN"
+
+struct CacheHeader
+{
+	uint32_t magic;
+	uint32_t format;
+	uint64_t key;
+	uint32_t length;
+};
+
+static bool available()
+{
+	if(PHYSFS_getWriteDir() == nullptr)
+		return false;
+	GLint formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	return (formats > 0);
+}
+
+static void fileName(char * buffer, size_t size, uint64_t key)
+{
+	snprintf(buffer, size, CACHE_DIR "/%016llx.bin", (unsigned long long)key);
+}
+
+uint64_t ProgramCache::begin()
+{
+	// FNV-1a, seeded with the driver
+	uint64_t key = 14695981039346656037ULL;
+	GLenum const strings[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+	for(GLenum name : strings)
+	{
+		char const * str = (char const *)glGetString(name);
+		if(str != nullptr)
+			key = feed(key, str, strlen(str));
+	}
+	return key;
+}
+
+uint64_t ProgramCache::feed(uint64_t key, void const * data, size_t length)
+{
+	uint8_t const * bytes = (uint8_t const *)data;
+	for(size_t i = 0; i < length; i++)
+	{
+		key ^= bytes[i];
+		key *= 1099511628211ULL;
+	}
+	return key;
+}
+
+bool ProgramCache::load(GLuint program, uint64_t key)
+{
+	if(!available())
+		return false;
+
+	char name[64];
+	fileName(name, sizeof(name), key);
+	if(!PHYSFS_exists(name))
+		return false;
+
+	PHYSFS_File * file = PHYSFS_openRead(name);
+	if(file == nullptr)
+		return false;
+
+	CacheHeader header;
+	std::vector<uint8_t> binary;
+	bool valid = (PHYSFS_readBytes(file, &header, sizeof(header)) == sizeof(header))
+		&& (header.magic == CACHE_MAGIC)
+		&& (header.key == key);
+	if(valid)
+	{
+		binary.resize(header.length);
+		valid = (PHYSFS_readBytes(file, binary.data(), binary.size()) == PHYSFS_sint64(binary.size()));
+	}
+	PHYSFS_close(file);
+	if(!valid) {
+		engine_log("Shader cache entry %s is corrupt.", name);
+		return false;
+	}
+
+	glProgramBinary(program, header.format, binary.data(), binary.size());
+
+	// The driver rejects binaries it can't use anymore
+	GLint status;
+	glGetProgramiv(program, GL_LINK_STATUS, &status);
+	return (status == GL_TRUE);
+}
+
+void ProgramCache::store(GLuint program, uint64_t key)
+{
+	if(!available())
+		return;
+
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if(length <= 0)
+		return;
+
+	CacheHeader header;
+	header.magic = CACHE_MAGIC;
+	header.key = key;
+	header.length = length;
+
+	std::vector<uint8_t> binary(length);
+	GLenum format;
+	glGetProgramBinary(program, length, nullptr, &format, binary.data());
+	header.format = format;
+
+	PHYSFS_mkdir(CACHE_DIR);
+
+	char name[64];
+	fileName(name, sizeof(name), key);
+	PHYSFS_File * file = PHYSFS_openWrite(name);
+	if(file == nullptr) {
+		engine_log("Failed to write shader cache entry %s: %s", name, PHYSFS_getLastError());
+		return;
+	}
+	bool success =
+		   (PHYSFS_writeBytes(file, &header, sizeof(header)) == sizeof(header))
+		&& (PHYSFS_writeBytes(file, binary.data(), binary.size()) == PHYSFS_sint64(binary.size()));
+	PHYSFS_close(file);
+
+	if(!success) {
+		// Don't leave a truncated entry behind
+		PHYSFS_delete(name);
+	}
+}
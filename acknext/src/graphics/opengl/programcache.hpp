@@ -0,0 +1,27 @@
+#ifndef PROGRAMCACHE_HPP
+#define PROGRAMCACHE_HPP
+
+#include <engine.hpp>
+#include <stdint.h>
+
+// Stores linked program binaries in the PhysFS write directory under
+// "shadercache/". Entries are keyed by a hash over all sources, their
+// stages and the driver strings, so a driver update or any change in
+// the sources misses the cache and the program is compiled again.
+class ProgramCache
+{
+public:
+	ProgramCache() = delete;
+
+	// Starts a new key
+	static uint64_t begin();
+
+	static uint64_t feed(uint64_t key, void const * data, size_t length);
+
+	// Loads the binary into the program, returns true if it linked
+	static bool load(GLuint program, uint64_t key);
+
+	static void store(GLuint program, uint64_t key);
+};
+
+#endif // PROGRAMCACHE_HPP
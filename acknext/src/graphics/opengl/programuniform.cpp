@@ -1,9 +1,17 @@
 #include <engine.hpp>
 #include "shader.hpp"
+#include "glstate.hpp"
 
+#include <string.h>
+
+// Uploads are skipped when the program already has the value
 #define FUNC(_type, call) template<> void glProgramUniform<_type>(int p, UniformProxy<_type> & proxy, int l, _type const & v) { \
-	(void)proxy; \
+	bool changed = !proxy.cached || memcmp(&proxy.value, &v, sizeof(_type)) != 0; \
+	if(!GLState::update(changed)) \
+		return; \
 	call; \
+	proxy.value = v; \
+	proxy.cached = true; \
 } \
 
 FUNC(bool, glProgramUniform1i(p, l, v ? GL_TRUE : GL_FALSE))
@@ -17,6 +25,11 @@ FUNC(COLOR, glProgramUniform4f(p, l, v.red, v.green, v.blue, v.alpha))
 
 template<> void glProgramUniform<BITMAP*>(int p, UniformProxy<BITMAP*> & proxy, int l, BITMAP * const & v)
 {
-	glProgramUniform1i(p, l, proxy.uniform->textureSlot);
-	glBindTextureUnit(proxy.uniform->textureSlot, v ? v->object : 0);
+	// The sampler keeps its slot from shader_link, only the
+	// texture unit binding is shared between all programs.
+	if(GLState::update(!proxy.cached)) {
+		glProgramUniform1i(p, l, proxy.uniform->textureSlot);
+		proxy.cached = true;
+	}
+	GLState::bindTexture(proxy.uniform->textureSlot, v ? v->object : 0);
 }
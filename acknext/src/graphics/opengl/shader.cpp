@@ -1,6 +1,9 @@
 #include "shader.hpp"
 
 #include "../core/glenum-translator.hpp"
+#include "glstate.hpp"
+#include "programcache.hpp"
+#include "../../virtfs/resourcecache.hpp"
 
 Shader::Shader() :
     EngineObject<SHADER>(),
@@ -8,7 +11,8 @@ Shader::Shader() :
 #define _UNIFORM(xname, xtype, value, _rtype) xname(),
 #include "uniformconfig.h"
 #undef _UNIFORM
-    stub(42) // required for termination
+    stub(42), // required for termination
+    viewStamp(0)
 {
 	api().object = glCreateProgram();
 #define _UNIFORM(xname, xtype, value, _rtype) this->xname.shader = this;
@@ -21,9 +25,77 @@ Shader::~Shader()
 	for(GLuint sh : this->shaders) {
 		glDeleteShader(sh);
 	}
+	GLState::forgetProgram(api().object);
 	glDeleteProgram(api().object);
 }
 
+// Objects are never removed from the cache, so flush it when it grows too large
+#define BINDING_CACHE_LIMIT 1024
+
+static bool isUploadable(GLenum type)
+{
+	switch(type)
+	{
+		case GL_INT:
+		case GL_INT_VEC2:
+		case GL_INT_VEC3:
+		case GL_INT_VEC4:
+		case GL_FLOAT:
+		case GL_FLOAT_VEC2:
+		case GL_FLOAT_VEC3:
+		case GL_FLOAT_VEC4:
+			return true;
+		// TODO: Add more
+		default:
+			return Property::isSampler(type);
+	}
+}
+
+BindingList const & Shader::bindingsOf(BaseEngineObject const * object)
+{
+	if(this->bindings.size() >= BINDING_CACHE_LIMIT && this->bindings.count(object) == 0)
+		this->bindings.clear();
+
+	BindingList & list = this->bindings[object];
+	if(list.stamp == object->propertyStamp)
+		return list;
+
+	list.stamp = object->propertyStamp;
+	list.uniforms.clear();
+	for(size_t i = 0; i < object->properties.size(); i++)
+	{
+		auto it = this->uniformsById.find(object->properties[i].first);
+		if(it == this->uniformsById.end())
+			continue;
+		UNIFORM const * uni = it->second;
+		Property const & p = object->properties[i].second;
+		if(uni->type != p.type) {
+			engine_log("Warning: %s does not match the shader specification!", uni->name);
+			continue;
+		}
+		if(!isUploadable(p.type)) {
+			engine_log("Warning: %s has an unsupported property type!", uni->name);
+			continue;
+		}
+		if(uni->location < 0) {
+			continue; // in a uniform block
+		}
+		list.uniforms.push_back(UniformBinding { uni, i });
+	}
+	return list;
+}
+
+// Drops the cached value of an engine uniform written without its proxy
+static void invalidateUniform(Shader * shader, int var)
+{
+	switch(var) {
+#define _UNIFORM(xname, xtype, value, _rtype) \
+		case value: shader->xname.invalidate(); break;
+#include "uniformconfig.h"
+#undef _UNIFORM
+	}
+}
+
 static bool addSource(SHADER * _shader, GLenum type, const char * source, GLint * size)
 {
 	Shader * shader = promote<Shader>(_shader);
@@ -36,11 +108,29 @@ static bool addSource(SHADER * _shader, GLenum type, const char * source, GLint
 		return false;
 	}
 
+	// Compiling is deferred to shader_link so a cached program binary
+	// can skip it entirely
+	if(size != nullptr)
+		shader->sources.emplace_back(type, std::string(source, *size));
+	else
+		shader->sources.emplace_back(type, std::string(source));
+
+	if(type == TESSCTRLSHADER || type == TESSEVALSHADER) {
+		shader->api().flags |= TESSELATION;
+	}
+
+	return true;
+}
+
+static bool compileSource(Shader * shader, GLenum type, std::string const & source)
+{
 	GLuint sh = glCreateShader(type);
 	if(sh == 0) {
 		return false;
 	}
-	glShaderSource(sh, 1, &source, size);
+	GLchar const * text = source.c_str();
+	GLint size = source.size();
+	glShaderSource(sh, 1, &text, &size);
 	glCompileShader(sh);
 
 	GLint status;
@@ -66,10 +156,6 @@ static bool addSource(SHADER * _shader, GLenum type, const char * source, GLint
 	shader->shaders.push_back(sh);
 	glAttachShader(shader->api().object, sh);
 
-	if(type == TESSCTRLSHADER || type == TESSEVALSHADER) {
-		shader->api().flags |= TESSELATION;
-	}
-
 	return true;
 }
 
@@ -93,13 +179,17 @@ ACKNEXT_API_BLOCK
 
 	bool shader_addFileSource(SHADER * shader, GLenum type, const char * fileName)
 	{
-		BLOB * blob = blob_load(fileName);
+		BLOB * blob = (BLOB*)ResourceCache::acquire(TYPE_BLOB, fileName);
 		if(!blob) {
-			engine_log("Failed to open %s file: %s", GLenumToString(type), fileName);
-			return false;
+			blob = blob_load(fileName);
+			if(!blob) {
+				engine_log("Failed to open %s file: %s", GLenumToString(type), fileName);
+				return false;
+			}
+			ResourceCache::insert(TYPE_BLOB, fileName, blob, blob->size);
 		}
-		bool result = shader_addSource(shader, type, (char*)blob->data);
-		blob_remove(blob);
+		bool result = shader_addSourceExt(shader, type, blob->data, blob->size);
+		ResourceCache::release(blob);
 		return result;
 	}
 
@@ -117,7 +207,35 @@ ACKNEXT_API_BLOCK
 		GLint status;
 		GLuint const program = shader->api().object;
 
-		glLinkProgram(program);
+		uint64_t key = ProgramCache::begin();
+		for(auto const & source : shader->sources) {
+			uint64_t const length = source.second.size();
+			key = ProgramCache::feed(key, &source.first, sizeof(GLenum));
+			key = ProgramCache::feed(key, &length, sizeof(length));
+			key = ProgramCache::feed(key, source.second.data(), length);
+		}
+
+		bool const cached = ProgramCache::load(program, key);
+		if(!cached)
+		{
+			for(auto const & source : shader->sources)
+			{
+				if(compileSource(shader, source.first, source.second))
+					continue;
+				for(GLuint sh : shader->shaders) {
+					glDetachShader(program, sh);
+					glDeleteShader(sh);
+				}
+				shader->shaders.clear();
+				shader->sources.clear();
+				engine_seterror(ERR_INVALIDOPERATION, "Failed to compile shader!");
+				return false;
+			}
+			glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+			glLinkProgram(program);
+		}
+		shader->sources.clear();
+
 		glGetProgramiv(program, GL_LINK_STATUS, &status);
 
 		GLint len;
@@ -141,6 +259,9 @@ ACKNEXT_API_BLOCK
 		if(len > 0) {
 			engine_log("link log: %s", log.data());
 		}
+		if(!cached) {
+			ProgramCache::store(program, key);
+		}
 
 		_shader->textureSlotCount = 0;
 		{
@@ -162,7 +283,7 @@ ACKNEXT_API_BLOCK
 				uni->block = -1; // No block by default
 				uni->location = glGetUniformLocation(program, uni->name);
 
-				shader->uniformsByName.emplace(uni->name, uni);
+				shader->uniformsById.emplace(PropertyName::intern(uni->name), uni);
 
 	#define _UNIFORM(xname, xtype, value, _rtype) \
 				do { \
@@ -172,13 +293,31 @@ ACKNEXT_API_BLOCK
 							return false; \
 						} \
 						uni->var = value; \
-						shader->xname.uniform = uni; \
+						shader->xname.invalidate(); \
+						if(uni->location >= 0) /* not in a block */ \
+							shader->xname.uniform = uni; \
 					} \
 				} while(false);
 	#include "uniformconfig.h"
 	#undef _UNIFORM
 
-				if(Property::isSampler(uni->type))
+				int unit = -1;
+				if(strcmp(uni->name, "texBones") == 0)
+					unit = BONEPALETTE_UNIT;
+				else if(strcmp(uni->name, "texLightData") == 0)
+					unit = LIGHTDATA_UNIT;
+				else if(strcmp(uni->name, "texLightClusters") == 0)
+					unit = LIGHTCLUSTERS_UNIT;
+				else if(strcmp(uni->name, "texLightIndices") == 0)
+					unit = LIGHTINDICES_UNIT;
+
+				if(unit >= 0)
+				{
+					// bound once per view by the renderer
+					uni->textureSlot = unit;
+					glProgramUniform1i(program, uni->location, unit);
+				}
+				else if(Property::isSampler(uni->type))
 				{
 					// preinitialize uniforms with correct slut
 					uni->textureSlot = _shader->textureSlotCount++;
@@ -204,6 +343,13 @@ ACKNEXT_API_BLOCK
 					// Now associate each uniform with its uniform block
 					shader->uniforms[locations[j]].block = i;
 				}
+
+				glGetActiveUniformBlockiv(program, i, GL_UNIFORM_BLOCK_NAME_LENGTH, &len);
+				char name[len + 1];
+				glGetActiveUniformBlockName(program, i, len + 1, NULL, name);
+
+				if(strcmp(name, "FrameBlock") == 0)
+					glUniformBlockBinding(program, i, FRAMEBLOCK_BINDING);
 			}
 		}
 
@@ -299,15 +445,12 @@ ACKNEXT_API_BLOCK
 		if(cnt < 0) {
 			return nullptr;
 		}
-		return promote<Shader>(shader)->uniformsByName[name];
-		for(int i = 0; i < cnt; i++)
-		{
-			UNIFORM const * uni = shader_getUniform(shader, i);
-			if(strcmp(uni->name, name) == 0) {
-				return uni;
-			}
+		Shader const * sh = promote<Shader>(shader);
+		auto it = sh->uniformsById.find(PropertyName::find(name));
+		if(it == sh->uniformsById.end()) {
+			return nullptr;
 		}
-		return nullptr;
+		return it->second;
 	}
 
 	void shader_setUniforms(SHADER * shader, void const * source, bool override)
@@ -327,17 +470,10 @@ ACKNEXT_API_BLOCK
 			return;
 		}
 		const GLuint pgm = shader->object;
-		for(auto const & prop : dummy->properties)
+		for(UniformBinding const & binding : sh->bindingsOf(dummy).uniforms)
 		{
-			UNIFORM const * uni = sh->uniformsByName[prop.first];
-			if(uni == nullptr) {
-				continue;
-			}
-			Property const & p = prop.second;
-			if(uni->type != p.type) {
-				engine_log("Warning: %s does not match the shader specification!", uni->name);
-				continue;
-			}
+			UNIFORM const * uni = binding.uniform;
+			Property const & p = dummy->properties[binding.property].second;
 			const int loc = uni->location;
 
 			if(p.isSampler())
@@ -374,11 +510,10 @@ ACKNEXT_API_BLOCK
 					case GL_FLOAT_VEC4:
 						glProgramUniform4f(pgm, loc, p.data.floats[0], p.data.floats[1], p.data.floats[2], p.data.floats[3]);
 						break;
-					// TODO: Add more, also add support for samplers!
-					default:
-						engine_log("Warning: %s has an unsupported property type!", uni->name);
+					default: // filtered by bindingsOf
 						continue;
 				}
+				invalidateUniform(sh, uni->var);
 			}
 		}
 	}
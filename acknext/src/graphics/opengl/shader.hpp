@@ -6,6 +6,16 @@
 #include <map>
 #include <string>
 #include <functional>
+#include <unordered_map>
+
+// Binding points of the engine uniform blocks, assigned when linking
+#define FRAMEBLOCK_BINDING 1
+
+// Texture units of the per-view buffers, assigned when linking
+#define BONEPALETTE_UNIT   12
+#define LIGHTDATA_UNIT     13
+#define LIGHTCLUSTERS_UNIT 14
+#define LIGHTINDICES_UNIT  15
 
 enum SHADERVAR
 {
@@ -32,14 +42,32 @@ friend void glProgramUniform<T>(int program, UniformProxy<T> & proxy, int locati
 private:
 	Shader * shader;
 	UNIFORM * uniform;
+	T value; // last uploaded value
+	bool cached;
 public:
-	UniformProxy() : shader(nullptr), uniform(nullptr) { }
+	UniformProxy() : shader(nullptr), uniform(nullptr), value(), cached(false) { }
 	NOCOPY(UniformProxy);
 	~UniformProxy() = default;
 
 	inline void operator =(T const & value);
 
 	bool present() const { return (this->uniform != nullptr); }
+
+	// The uniform was changed without the proxy
+	void invalidate() { this->cached = false; }
+};
+
+// Uniform fed by a property of the object passed to shader_setUniforms
+struct UniformBinding
+{
+	UNIFORM const * uniform;
+	size_t property; // index in the object's properties
+};
+
+struct BindingList
+{
+	uint64_t stamp; // propertyStamp of the object
+	std::vector<UniformBinding> uniforms;
 };
 
 class Shader : public EngineObject<SHADER>
@@ -48,15 +76,22 @@ class Shader : public EngineObject<SHADER>
 public:
 	std::vector<UNIFORM> uniforms;
 	std::vector<GLuint> shaders;
-	mutable std::map<std::string, UNIFORM*> uniformsByName;
+	std::vector<std::pair<GLenum, std::string>> sources; // compiled by shader_link
+	std::unordered_map<PropertyID, UNIFORM*> uniformsById;
+	std::unordered_map<BaseEngineObject const *, BindingList> bindings;
 #define _UNIFORM(xname, xtype, value, _rtype) UniformProxy<_rtype> xname;
 #include "uniformconfig.h"
 #undef _UNIFORM
 	int stub;
+	unsigned int viewStamp; // last view that set the frame uniforms
 public:
 	Shader();
 	NOCOPY(Shader);
 	~Shader();
+
+	// Properties of object that match a uniform, rebuilt only when
+	// the object gains or loses properties
+	BindingList const & bindingsOf(BaseEngineObject const * object);
 };
 
 
@@ -38,6 +38,7 @@ _UNIFORM(iLightCount, GL_INT, ILIGHTCOUNT_VAR, int)
 
 _UNIFORM(useInstancing, GL_BOOL, USEINSTANCING_VAR, int)
 _UNIFORM(useBones, GL_BOOL, USEBONES_VAR, int)
+_UNIFORM(iBoneOffset, GL_INT, IBONEOFFSET_VAR, int)
 _UNIFORM(useNormalMapping, GL_BOOL, USENORMALMAPPING_VAR, int)
 
 // Post Processing:
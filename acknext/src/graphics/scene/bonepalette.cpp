@@ -0,0 +1,210 @@
+#include "bonepalette.hpp"
+#include "model.hpp"
+
+#include "../../core/jobsystem.hpp"
+#include "../../scene/entity.hpp"
+
+#include <stddef.h>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+// Cache entries not used by this many palettes are dropped
+#define CACHE_LIFETIME 64
+
+// Position, rotation and scale of a FRAME, the time is irrelevant for the pose
+#define FRAME_POSE_OFFSET offsetof(FRAME, position)
+#define FRAME_POSE_SIZE   (offsetof(FRAME, scale) + sizeof(VECTOR) - offsetof(FRAME, position))
+
+// dst = lhs * rhs in column major order, dst must not alias the inputs
+static inline void multiply(MATRIX & dst, MATRIX const & lhs, MATRIX const & rhs)
+{
+#ifdef __SSE__
+	__m128 const c0 = _mm_loadu_ps(lhs.fields[0]);
+	__m128 const c1 = _mm_loadu_ps(lhs.fields[1]);
+	__m128 const c2 = _mm_loadu_ps(lhs.fields[2]);
+	__m128 const c3 = _mm_loadu_ps(lhs.fields[3]);
+	for(int i = 0; i < 4; i++)
+	{
+		__m128 col = _mm_mul_ps(c0, _mm_set1_ps(rhs.fields[i][0]));
+		col = _mm_add_ps(col, _mm_mul_ps(c1, _mm_set1_ps(rhs.fields[i][1])));
+		col = _mm_add_ps(col, _mm_mul_ps(c2, _mm_set1_ps(rhs.fields[i][2])));
+		col = _mm_add_ps(col, _mm_mul_ps(c3, _mm_set1_ps(rhs.fields[i][3])));
+		_mm_storeu_ps(dst.fields[i], col);
+	}
+#else
+	for(int i = 0; i < 4; i++)
+	{
+		for(int r = 0; r < 4; r++)
+		{
+			dst.fields[i][r] =
+				  lhs.fields[0][r] * rhs.fields[i][0]
+				+ lhs.fields[1][r] * rhs.fields[i][1]
+				+ lhs.fields[2][r] * rhs.fields[i][2]
+				+ lhs.fields[3][r] * rhs.fields[i][3];
+		}
+	}
+#endif
+}
+
+// Same as mat_translate, mat_rotate and mat_scale on an identity matrix
+static inline void compose(MATRIX & dst, FRAME const & frame)
+{
+	QUATERNION const & q = frame.rotation;
+	VECTOR const & s = frame.scale;
+
+	var const xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+	var const xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+	var const wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+
+	dst.fields[0][0] = s.x * (1 - 2 * (yy + zz));
+	dst.fields[0][1] = s.x * (2 * (xy + wz));
+	dst.fields[0][2] = s.x * (2 * (xz - wy));
+	dst.fields[0][3] = 0;
+
+	dst.fields[1][0] = s.y * (2 * (xy - wz));
+	dst.fields[1][1] = s.y * (1 - 2 * (xx + zz));
+	dst.fields[1][2] = s.y * (2 * (yz + wx));
+	dst.fields[1][3] = 0;
+
+	dst.fields[2][0] = s.z * (2 * (xz + wy));
+	dst.fields[2][1] = s.z * (2 * (yz - wx));
+	dst.fields[2][2] = s.z * (1 - 2 * (xx + yy));
+	dst.fields[2][3] = 0;
+
+	dst.fields[3][0] = frame.position.x;
+	dst.fields[3][1] = frame.position.y;
+	dst.fields[3][2] = frame.position.z;
+	dst.fields[3][3] = 1;
+}
+
+static bool samePose(FRAME const * a, FRAME const * b, int count)
+{
+	for(int i = 0; i < count; i++)
+	{
+		char const * lhs = reinterpret_cast<char const *>(&a[i]) + FRAME_POSE_OFFSET;
+		char const * rhs = reinterpret_cast<char const *>(&b[i]) + FRAME_POSE_OFFSET;
+		if(memcmp(lhs, rhs, FRAME_POSE_SIZE) != 0)
+			return false;
+	}
+	return true;
+}
+
+BonePalette::BonePalette() :
+    skeletons(),
+    offsets(),
+    cache(),
+    matrices(),
+    generation(0)
+{
+
+}
+
+void BonePalette::clear()
+{
+	this->skeletons.clear();
+	this->offsets.clear();
+	this->matrices.clear();
+
+	this->generation += 1;
+	if((this->generation % CACHE_LIFETIME) == 0)
+	{
+		for(auto it = this->cache.begin(); it != this->cache.end(); )
+		{
+			if(this->generation - it->second.generation > CACHE_LIFETIME)
+				it = this->cache.erase(it);
+			else
+				++it;
+		}
+	}
+}
+
+uint32_t BonePalette::add(ENTITY const * ent)
+{
+	auto it = this->offsets.find(ent);
+	if(it != this->offsets.end())
+		return it->second;
+
+	Skeleton skeleton;
+	skeleton.model = ent->model;
+	skeleton.offset = this->matrices.size();
+
+	// Entities without own pose use the models default pose
+	Model const * model = promote<Model>(ent->model);
+	skeleton.rest = model->defaultPose();
+	skeleton.pose = ent->pose;
+	if(ent->poseCount < ent->model->boneCount)
+		skeleton.pose = skeleton.rest;
+
+	// Marked by the draw list of this view
+	size_t const idx = EntityStorage::denseIndex(promote<Entity>(ent)->handle);
+	skeleton.depths = model->boneDepths();
+	skeleton.maxDepth = ACKNEXT_MAX_BONES;
+	if(EntityStorage::drawnFrames[idx] == uint32_t(total_frames) + 1)
+		skeleton.maxDepth = lod_bonedepths[EntityStorage::lods[idx]];
+
+	// Elements of an unordered_map don't move, the jobs can keep the pointer
+	skeleton.cache = &this->cache[ent];
+	skeleton.cache->generation = this->generation;
+
+	this->skeletons.push_back(skeleton);
+	this->matrices.resize(this->matrices.size() + ent->model->boneCount);
+	this->offsets.emplace(ent, skeleton.offset);
+	return skeleton.offset;
+}
+
+uint32_t BonePalette::offsetOf(ENTITY const * ent) const
+{
+	auto it = this->offsets.find(ent);
+	assert(it != this->offsets.end());
+	return it->second;
+}
+
+void BonePalette::evaluate()
+{
+	// Skeletons are independent, each one writes only its palette range and cache
+	JobSystem::parallelFor(this->skeletons.size(), 16, [this](size_t begin, size_t end, int)
+	{
+		for(size_t i = begin; i < end; i++)
+		{
+			Skeleton const & skeleton = this->skeletons[i];
+			evaluate(skeleton, &this->matrices[skeleton.offset]);
+		}
+	});
+}
+
+void BonePalette::evaluate(Skeleton const & skeleton, MATRIX * dst)
+{
+	MODEL const * model = skeleton.model;
+	int const count = model->boneCount;
+	Cache & cache = *skeleton.cache;
+
+	if(cache.model == model
+		&& cache.maxDepth == skeleton.maxDepth
+		&& int(cache.pose.size()) == count
+		&& samePose(cache.pose.data(), skeleton.pose, count))
+	{
+		memcpy(dst, cache.skin.data(), sizeof(MATRIX) * count);
+		return;
+	}
+
+	MATRIX transforms[ACKNEXT_MAX_BONES];
+	for(int i = 0; i < count; i++)
+	{
+		FRAME const & frame = (skeleton.depths[i] > skeleton.maxDepth) ? skeleton.rest[i] : skeleton.pose[i];
+		if(i == 0) {
+			compose(transforms[i], frame);
+		} else {
+			MATRIX local;
+			compose(local, frame);
+			multiply(transforms[i], transforms[model->bones[i].parent], local);
+		}
+		multiply(dst[i], transforms[i], model->bones[i].bindToBoneTransform);
+	}
+
+	cache.model = model;
+	cache.maxDepth = skeleton.maxDepth;
+	cache.pose.assign(skeleton.pose, skeleton.pose + count);
+	cache.skin.assign(dst, dst + count);
+}
@@ -0,0 +1,66 @@
+#ifndef BONEPALETTE_HPP
+#define BONEPALETTE_HPP
+
+#include <engine.hpp>
+
+#include <vector>
+#include <unordered_map>
+#include <stdint.h>
+
+// Skinning matrices of all animated entities drawn in a view, stored
+// back to back. Every entity gets the offset of its first bone, so
+// skinned meshes can be drawn instanced with a per-instance offset.
+// The renderer uploads the palette once per view as a buffer texture.
+class BonePalette
+{
+	// Last evaluated pose of an entity, reused while the pose is unchanged
+	struct Cache
+	{
+		MODEL const * model = nullptr;
+		std::vector<FRAME> pose;
+		std::vector<MATRIX> skin;
+		int maxDepth = -1;
+		uint32_t generation = 0;
+	};
+
+	struct Skeleton
+	{
+		MODEL const * model;
+		FRAME const * pose;
+		FRAME const * rest;     // used for bones deeper than maxDepth
+		uint8_t const * depths;
+		int maxDepth;
+		Cache * cache;
+		uint32_t offset;
+	};
+private:
+	std::vector<Skeleton> skeletons;
+	std::unordered_map<ENTITY const *, uint32_t> offsets;
+	std::unordered_map<ENTITY const *, Cache> cache;
+	std::vector<MATRIX> matrices;
+	uint32_t generation;
+public:
+	BonePalette();
+	NOCOPY(BonePalette);
+	~BonePalette() = default;
+
+	void clear();
+
+	// Reserves the bones of the entity once per palette, returns the offset.
+	// The bone depth is limited by the LOD stage the entity is drawn with.
+	uint32_t add(ENTITY const * ent);
+
+	// Offset of an entity passed to add()
+	uint32_t offsetOf(ENTITY const * ent) const;
+
+	// Computes the skinning matrices of all added entities on the job
+	// system. Skeletons whose pose did not change since they were last
+	// evaluated are copied from the cache.
+	void evaluate();
+
+	std::vector<MATRIX> const & data() const { return matrices; }
+private:
+	static void evaluate(Skeleton const & skeleton, MATRIX * dst);
+};
+
+#endif // BONEPALETTE_HPP
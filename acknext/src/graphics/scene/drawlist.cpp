@@ -0,0 +1,444 @@
+#include "drawlist.hpp"
+
+#include "model.hpp"
+#include "ackglm.hpp"
+#include "../../scene/entity.hpp"
+#include "../../scene/entitystorage.hpp"
+#include "../../core/jobsystem.hpp"
+
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+
+// Number of entities a worker processes in one go
+#define DRAWLIST_GRAIN 256
+
+// Sort key layout, from the highest bits down
+#define KEY_PASS_BITS     4
+#define KEY_SHADER_BITS   12
+#define KEY_MATERIAL_BITS 16
+#define KEY_CULL_BITS     1
+#define KEY_DEPTH_BITS    8
+#define KEY_MESH_BITS     16
+
+enum class HalfSpace
+{
+	Negative = -1,
+	OnPlane = 0,
+	Positive = 1,
+};
+
+struct Plane
+{
+	Plane() : xyz(0,0,0), w(0) { }
+
+	Plane(float x, float y, float z, float w) :
+	    xyz(x, y, z),
+	    w(w)
+	{
+		this->normalize();
+	}
+
+	glm::vec3 xyz;
+	float w;
+
+	void normalize()
+	{
+		float mag = glm::length(xyz);
+		this->xyz /= mag;
+		this->w   /= mag;
+	}
+
+	float distance(glm::vec3 const & pt) const
+	{
+		return this->xyz.x * pt.x + this->xyz.y * pt.y + this->xyz.z * pt.z + this->w;
+	}
+
+	float distance(VECTOR const & pt) const
+	{
+		return this->xyz.x * pt.x + this->xyz.y * pt.y + this->xyz.z * pt.z + this->w;
+	}
+
+	HalfSpace classify(glm::vec3 const & pt) const
+	{
+		float d = this->distance(pt);
+		if (d < 0)
+			return HalfSpace::Negative;
+		if (d > 0)
+			return HalfSpace::Positive;
+		return HalfSpace::OnPlane;
+	}
+};
+
+struct Frustrum
+{
+	Plane planes[6];
+
+	Frustrum(MATRIX const & modelView)
+	{
+		float m11 = modelView.fields[0][0];
+		float m12 = modelView.fields[1][0];
+		float m13 = modelView.fields[2][0];
+		float m14 = modelView.fields[3][0];
+
+		float m21 = modelView.fields[0][1];
+		float m22 = modelView.fields[1][1];
+		float m23 = modelView.fields[2][1];
+		float m24 = modelView.fields[3][1];
+
+		float m31 = modelView.fields[0][2];
+		float m32 = modelView.fields[1][2];
+		float m33 = modelView.fields[2][2];
+		float m34 = modelView.fields[3][2];
+
+		float m41 = modelView.fields[0][3];
+		float m42 = modelView.fields[1][3];
+		float m43 = modelView.fields[2][3];
+		float m44 = modelView.fields[3][3];
+
+		/*left*/   planes[0] = Plane(m41 + m11, m42 + m12, m43 + m13, m44 + m14);
+		/*right*/  planes[1] = Plane(m41 - m11, m42 - m12, m43 - m13, m44 - m14);
+		/*bottom*/ planes[2] = Plane(m41 + m21, m42 + m22, m43 + m23, m44 + m24);
+		/*top*/    planes[3] = Plane(m41 - m21, m42 - m22, m43 - m23, m44 - m24);
+		/*near*/   planes[4] = Plane(m41 + m31, m42 + m32, m43 + m33, m44 + m34);
+		/*far*/    planes[5] = Plane(m41 - m31, m42 - m32, m43 - m33, m44 - m34);
+
+		for(int i = 0; i < 6; i++)
+			planes[i].normalize();
+	}
+};
+
+static bool cull(Frustrum const & frustrum, VECTOR const & position, float radius)
+{
+	var threshold = -radius;
+
+	for(int i = 0; i < 6; i++)
+	{
+		float dist = frustrum.planes[i].distance(position);
+		if(dist < threshold)
+			return true;
+	}
+	return false;
+}
+
+DrawList::DrawList() :
+    chunks(),
+    lookup(),
+    groups(),
+    drawcallCount(0),
+    idTable(), idStamp(0), idCount(0),
+    keys(), keyScratch(),
+    indices(), indexScratch(),
+    sortedGroups(),
+    changes(0), changesAvoided(0)
+{
+
+}
+
+void DrawList::build(
+	MATRIX const & matViewProj,
+	VECTOR const & lodOrigin,
+	MATERIAL const * mtlOverride)
+{
+	Frustrum const clipFrustrum(matViewProj);
+
+	size_t entityCount = EntityStorage::size();
+	size_t chunkCount = (entityCount + DRAWLIST_GRAIN - 1) / DRAWLIST_GRAIN;
+	if(this->chunks.size() < chunkCount)
+		this->chunks.resize(chunkCount);
+
+	// Runs linearly over the packed entity arrays, each
+	// index is only visited by a single worker.
+	JobSystem::parallelFor(entityCount, DRAWLIST_GRAIN, [&](size_t begin, size_t end, int)
+	{
+		std::vector<Drawcall> & calls = this->chunks[begin / DRAWLIST_GRAIN];
+		calls.clear();
+
+		for(size_t idx = begin; idx < end; idx++)
+		{
+			EntityStorage::refresh(idx);
+
+			MODEL const * model = EntityStorage::models[idx];
+			if(model == nullptr)
+				continue;
+			if(!(EntityStorage::flags[idx] & VISIBLE))
+				continue;
+			// TODO: Filter entity by mask bits
+
+			VECTOR const & position = EntityStorage::positions[idx];
+			if(cull(clipFrustrum, position, EntityStorage::radii[idx]))
+				continue;
+
+			var dist = vec_dist(&lodOrigin, &position);
+			uint lod;
+			for(lod = 15; lod_distances[lod] > dist && lod > 0; lod--);
+
+			if(lod > model->minimumLOD)
+				continue;
+
+			EntityStorage::markDrawn(idx, lod);
+
+			ENTITY const * ent = &EntityStorage::objects[idx]->api();
+			for(int i = 0; i < model->meshCount; i++)
+			{
+				MESH const * mesh = model->meshes[i];
+
+				// Only allow rendering of meshes when the
+				// LOD is enabled in the MESH
+				if(!(mesh->lodMask & (1<<lod)))
+					continue;
+
+				float radius = 0;
+				radius = glm::max(radius, glm::abs(mesh->boundingBox.minimum.x));
+				radius = glm::max(radius, glm::abs(mesh->boundingBox.minimum.y));
+				radius = glm::max(radius, glm::abs(mesh->boundingBox.minimum.z));
+				radius = glm::max(radius, glm::abs(mesh->boundingBox.maximum.x));
+				radius = glm::max(radius, glm::abs(mesh->boundingBox.maximum.y));
+				radius = glm::max(radius, glm::abs(mesh->boundingBox.maximum.z));
+
+				// And only render it, when the
+				// mesh is actually visible
+				if(cull(clipFrustrum, position, radius))
+					continue;
+
+				Drawcall call;
+				if(mtlOverride != nullptr)
+					call.material = mtlOverride;
+				else if(ent->material == nullptr)
+					call.material = model->materials[i];
+				else
+					call.material = ent->material;
+				call.matWorld = EntityStorage::transforms[idx];
+				call.model = model;
+				call.mesh = mesh;
+				call.ent = ent;
+				call.renderDoubleSided = !!(mesh->lodMask & DOUBLESIDED);
+
+				calls.push_back(call);
+			}
+		}
+	});
+
+	// Merge the chunks in order, so the result does not depend
+	// on how the work was distributed.
+	for(Group & group : this->groups)
+		group.instances.clear();
+
+	this->drawcallCount = 0;
+	Drawgroup lastParams;
+	Group * lastGroup = nullptr;
+	for(size_t c = 0; c < chunkCount; c++)
+	{
+		for(Drawcall const & call : this->chunks[c])
+		{
+			Drawgroup params;
+			params.mtl = call.material;
+			params.mesh = call.mesh;
+			params.model = call.model;
+			params.doublesided = call.renderDoubleSided;
+
+			// Consecutive meshes of similar entities often share a group
+			if(lastGroup == nullptr || !(lastParams == params))
+			{
+				auto it = this->lookup.find(params);
+				if(it == this->lookup.end()) {
+					it = this->lookup.emplace(params, this->groups.size()).first;
+					this->groups.emplace_back();
+					this->groups.back().params = params;
+				}
+				lastGroup = &this->groups[it->second];
+				lastParams = params;
+			}
+
+			Instance instance;
+			instance.ent = call.ent;
+			instance.transform = call.matWorld;
+			if(lastGroup->instances.empty())
+				lastGroup->distance = FLT_MAX;
+			lastGroup->instances.push_back(instance);
+
+			VECTOR const position = {
+				call.matWorld.fields[3][0],
+				call.matWorld.fields[3][1],
+				call.matWorld.fields[3][2] };
+			lastGroup->distance = std::min(lastGroup->distance, vec_dist(&lodOrigin, &position));
+
+			this->drawcallCount += 1;
+		}
+	}
+
+	this->compact();
+	this->sort();
+}
+
+void DrawList::compact()
+{
+	// Groups stay alive when unused so their arrays can be reused,
+	// but drop them when most of the list is dead weight (removed
+	// materials or meshes would otherwise pile up forever).
+	size_t unused = 0;
+	for(Group const & group : this->groups)
+		unused += group.instances.empty() ? 1 : 0;
+	if(unused < 64 || unused < this->groups.size() / 2)
+		return;
+
+	this->groups.erase(
+		std::remove_if(this->groups.begin(), this->groups.end(), [](Group const & group) {
+			return group.instances.empty();
+		}),
+		this->groups.end());
+
+	this->lookup.clear();
+	for(size_t i = 0; i < this->groups.size(); i++)
+		this->lookup.emplace(this->groups[i].params, i);
+}
+
+static inline size_t idHash(void const * object, size_t mask)
+{
+	uint64_t h = uint64_t(reinterpret_cast<uintptr_t>(object)) * 0x9E3779B97F4A7C15ull;
+	return size_t(h >> 32) & mask;
+}
+
+uint32_t DrawList::id(void const * object)
+{
+	// Grow at half load, the table is kept across frames
+	if(2 * (this->idCount + 1) > this->idTable.size())
+	{
+		std::vector<IdSlot> old;
+		old.swap(this->idTable);
+		this->idTable.resize(std::max<size_t>(256, 2 * old.size()), IdSlot { nullptr, 0, 0 });
+		size_t const mask = this->idTable.size() - 1;
+		for(IdSlot const & slot : old)
+		{
+			if(slot.stamp != this->idStamp)
+				continue;
+			size_t i = idHash(slot.key, mask);
+			while(this->idTable[i].stamp == this->idStamp)
+				i = (i + 1) & mask;
+			this->idTable[i] = slot;
+		}
+	}
+
+	size_t const mask = this->idTable.size() - 1;
+	size_t i = idHash(object, mask);
+	for(; this->idTable[i].stamp == this->idStamp; i = (i + 1) & mask)
+	{
+		if(this->idTable[i].key == object)
+			return this->idTable[i].id;
+	}
+	this->idTable[i] = IdSlot { object, this->idCount, this->idStamp };
+	return this->idCount++;
+}
+
+static inline uint64_t keyfield(uint64_t key, uint32_t value, int bits)
+{
+	uint32_t const max = (1u << bits) - 1;
+	return (key << bits) | std::min(value, max);
+}
+
+// Least significant digit first, passes where all keys
+// share the same digit are skipped.
+static void radixsort(
+	std::vector<uint64_t> & keys,
+	std::vector<uint32_t> & values,
+	std::vector<uint64_t> & keyScratch,
+	std::vector<uint32_t> & valueScratch)
+{
+	size_t const count = keys.size();
+	keyScratch.resize(count);
+	valueScratch.resize(count);
+	for(int shift = 0; shift < 64; shift += 8)
+	{
+		size_t offsets[256] = { 0 };
+		for(uint64_t key : keys)
+			offsets[(key >> shift) & 0xFF] += 1;
+		if(offsets[(keys[0] >> shift) & 0xFF] == count)
+			continue;
+
+		size_t sum = 0;
+		for(size_t & offset : offsets)
+		{
+			size_t n = offset;
+			offset = sum;
+			sum += n;
+		}
+		for(size_t i = 0; i < count; i++)
+		{
+			size_t dst = offsets[(keys[i] >> shift) & 0xFF]++;
+			keyScratch[dst] = keys[i];
+			valueScratch[dst] = values[i];
+		}
+		keys.swap(keyScratch);
+		values.swap(valueScratch);
+	}
+}
+
+static inline SHADER const * shaderOf(Drawgroup const & group)
+{
+	return group.mtl ? group.mtl->shader : nullptr;
+}
+
+static int countStateChanges(DrawList::Group const * prev, DrawList::Group const * next)
+{
+	if(prev == nullptr)
+		return 0;
+	Drawgroup const & a = prev->params;
+	Drawgroup const & b = next->params;
+	return (shaderOf(a) != shaderOf(b))
+		+ (a.mtl != b.mtl)
+		+ (a.doublesided != b.doublesided)
+		+ (a.mesh != b.mesh);
+}
+
+void DrawList::sort()
+{
+	// Bumping the stamp empties the id table without touching it
+	this->idStamp += 1;
+	if(this->idStamp == 0) {
+		for(IdSlot & slot : this->idTable)
+			slot.stamp = 0;
+		this->idStamp = 1;
+	}
+	this->idCount = 0;
+	this->keys.clear();
+	this->indices.clear();
+	this->sortedGroups.clear();
+
+	int unsorted = 0;
+	Group const * previous = nullptr;
+	for(size_t i = 0; i < this->groups.size(); i++)
+	{
+		Group const & group = this->groups[i];
+		if(group.instances.empty())
+			continue;
+		unsorted += countStateChanges(previous, &group);
+		previous = &group;
+
+		// Logarithmic distance buckets, finer close to the camera
+		uint32_t depth = uint32_t(16.0f * log2f(1.0f + group.distance));
+
+		uint64_t key = Opaque;
+		key = keyfield(key, this->id(shaderOf(group.params)), KEY_SHADER_BITS);
+		key = keyfield(key, this->id(group.params.mtl), KEY_MATERIAL_BITS);
+		key = keyfield(key, group.params.doublesided, KEY_CULL_BITS);
+		key = keyfield(key, depth, KEY_DEPTH_BITS);
+		key = keyfield(key, this->id(group.params.mesh), KEY_MESH_BITS);
+
+		this->keys.push_back(key);
+		this->indices.push_back(i);
+	}
+
+	if(this->keys.size() > 1)
+		radixsort(this->keys, this->indices, this->keyScratch, this->indexScratch);
+
+	this->changes = 0;
+	previous = nullptr;
+	for(uint32_t index : this->indices)
+	{
+		Group const * group = &this->groups[index];
+		this->changes += countStateChanges(previous, group);
+		this->sortedGroups.push_back(group);
+		previous = group;
+	}
+	this->changesAvoided = unsorted - this->changes;
+}
@@ -0,0 +1,131 @@
+#ifndef DRAWLIST_HPP
+#define DRAWLIST_HPP
+
+#include <engine.hpp>
+
+#include <vector>
+#include <unordered_map>
+
+struct Drawcall
+{
+	ENTITY const * ent = nullptr;
+	MODEL const * model = nullptr;
+	MESH const * mesh = nullptr;
+	MATERIAL const * material = nullptr;
+	MATRIX matWorld;
+	bool renderDoubleSided;
+};
+
+struct Drawgroup
+{
+	MATERIAL const * mtl = nullptr;
+	MESH const * mesh = nullptr;
+	MODEL const * model = nullptr;
+	bool doublesided = false;
+};
+
+static inline bool operator ==(Drawgroup const & lhs, Drawgroup const & rhs)
+{
+	return lhs.mtl == rhs.mtl
+		&& lhs.model == rhs.model
+		&& lhs.mesh == rhs.mesh
+		&& lhs.doublesided == rhs.doublesided;
+}
+
+class DrawgroupHash
+{
+public:
+	size_t operator()(const Drawgroup &group) const
+	{
+		size_t h1 = reinterpret_cast<size_t>(group.mtl);
+		size_t h2 = reinterpret_cast<size_t>(group.model);
+		size_t h3 = reinterpret_cast<size_t>(group.mesh);
+		size_t h4 = std::hash<bool>()(group.doublesided);
+		return h1 ^ (h2 << 1) ^ (h3 << 2) ^ (h4 << 3);
+	}
+};
+
+struct Instance
+{
+	// NOTE: MUST BE FIRST MEMBER OF
+	// STRUCT, OTHERWISE THE VERTEX ARRAY LAYOUT
+	// WILL MESS UP!
+	MATRIX transform;
+	uint32_t bones = 0; // offset in the bone palette, set by the renderer
+	ENTITY const * ent = nullptr;
+} __attribute__((packed));
+
+// Builds the per-frame list of instanced draw groups.
+// All storage is kept between frames and only grows, so
+// after warm-up a build does not touch the heap.
+class DrawList
+{
+public:
+	struct Group
+	{
+		Drawgroup params;
+		std::vector<Instance> instances;
+		float distance; // of the nearest instance
+	};
+
+	// Render passes, the highest bits of the sort key
+	enum Pass
+	{
+		Opaque = 0,
+	};
+private:
+	std::vector<std::vector<Drawcall>> chunks;
+	std::unordered_map<Drawgroup, size_t, DrawgroupHash> lookup;
+	std::vector<Group> groups;
+	size_t drawcallCount;
+
+	// Sorting, ids are assigned per frame through an open addressing
+	// table that is only valid for slots carrying the current stamp.
+	struct IdSlot
+	{
+		void const * key;
+		uint32_t id;
+		uint32_t stamp;
+	};
+	std::vector<IdSlot> idTable;
+	uint32_t idStamp, idCount;
+	std::vector<uint64_t> keys, keyScratch;
+	std::vector<uint32_t> indices, indexScratch;
+	std::vector<Group const *> sortedGroups;
+	int changes, changesAvoided;
+public:
+	DrawList();
+	NOCOPY(DrawList);
+	~DrawList() = default;
+
+	// Collects all visible meshes of all entities, lodOrigin
+	// is the point the LOD distance is measured from.
+	void build(
+		MATRIX const & matViewProj,
+		VECTOR const & lodOrigin,
+		MATERIAL const * mtlOverride);
+
+	// Groups may be empty when they were not used this frame
+	std::vector<Group> const & result() const { return groups; }
+
+	// Non-empty groups sorted by pass, shader, material, cull mode,
+	// distance (front to back) and mesh
+	std::vector<Group const *> const & queue() const { return sortedGroups; }
+
+	size_t drawcalls() const { return drawcallCount; }
+
+	// Shader, material, cull mode and mesh changes between
+	// the groups of queue()
+	int stateChanges() const { return changes; }
+
+	// State changes saved by sorting compared to the build order
+	int stateChangesAvoided() const { return changesAvoided; }
+private:
+	void compact();
+
+	void sort();
+
+	uint32_t id(void const * object);
+};
+
+#endif // DRAWLIST_HPP
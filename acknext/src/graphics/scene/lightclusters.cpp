@@ -0,0 +1,168 @@
+#include "lightclusters.hpp"
+
+#include "../../core/jobsystem.hpp"
+
+#include <math.h>
+#include <algorithm>
+
+static int tile(float ndc, int size)
+{
+	int t = int(floorf((0.5f * ndc + 0.5f) * size));
+	return std::min(std::max(t, 0), size - 1);
+}
+
+LightClusters::LightClusters() :
+    spheres(),
+    slices(sizeZ),
+    clusters(count),
+    indexList(),
+    zNear(0.1), zFar(1000.0),
+    projX(1.0), projY(1.0)
+{
+
+}
+
+float LightClusters::sliceDepth(int z) const
+{
+	return this->zNear * powf(this->zFar / this->zNear, float(z) / sizeZ);
+}
+
+float LightClusters::depthScale() const
+{
+	return sizeZ / logf(this->zFar / this->zNear);
+}
+
+float LightClusters::depthBias() const
+{
+	return -logf(this->zNear) * this->depthScale();
+}
+
+void LightClusters::build(
+	MATRIX const & matView,
+	MATRIX const & matProj,
+	float zNear,
+	float zFar,
+	Sphere const * lights,
+	size_t count)
+{
+	this->zNear = std::max(zNear, 0.001f);
+	this->zFar = std::max(zFar, this->zNear + 0.001f);
+	this->projX = matProj.fields[0][0];
+	this->projY = matProj.fields[1][1];
+
+	// Move the lights into view space and drop those outside the depth range
+	this->spheres.clear();
+	for(size_t i = 0; i < count; i++)
+	{
+		VECTOR const & p = lights[i].position;
+		Sphere s = lights[i];
+		s.position.x = matView.fields[0][0] * p.x + matView.fields[1][0] * p.y + matView.fields[2][0] * p.z + matView.fields[3][0];
+		s.position.y = matView.fields[0][1] * p.x + matView.fields[1][1] * p.y + matView.fields[2][1] * p.z + matView.fields[3][1];
+		s.position.z = -(matView.fields[0][2] * p.x + matView.fields[1][2] * p.y + matView.fields[2][2] * p.z + matView.fields[3][2]);
+		if(s.position.z + s.radius < this->zNear)
+			continue;
+		if(s.position.z - s.radius > this->zFar)
+			continue;
+		this->spheres.push_back(s);
+	}
+
+	// One slice per job, slices don't share any data
+	JobSystem::parallelFor(sizeZ, 1, [this](size_t begin, size_t end, int)
+	{
+		for(size_t z = begin; z < end; z++)
+			this->buildSlice(z);
+	});
+
+	uint32_t total = 0;
+	for(Slice & slice : this->slices)
+	{
+		slice.offset = total;
+		total += slice.indices.size();
+	}
+	this->indexList.resize(total);
+
+	JobSystem::parallelFor(sizeZ, 1, [this](size_t begin, size_t end, int)
+	{
+		for(size_t z = begin; z < end; z++)
+		{
+			Slice const & slice = this->slices[z];
+			Range * dst = &this->clusters[z * sizeX * sizeY];
+			for(int i = 0; i < sizeX * sizeY; i++)
+			{
+				dst[i].offset = slice.tiles[i].offset + slice.offset;
+				dst[i].count = slice.tiles[i].count;
+			}
+			std::copy(slice.indices.begin(), slice.indices.end(), this->indexList.begin() + slice.offset);
+		}
+	});
+}
+
+void LightClusters::buildSlice(int z)
+{
+	Slice & slice = this->slices[z];
+	float const d0 = this->sliceDepth(z);
+	float const d1 = this->sliceDepth(z + 1);
+
+	// Screen tiles covered by each light within the slice
+	slice.rects.clear();
+	for(Sphere const & s : this->spheres)
+	{
+		float depth = s.position.z;
+		if(depth + s.radius < d0 || depth - s.radius > d1)
+			continue;
+		float e0 = std::max(d0, depth - s.radius);
+		float e1 = std::min(d1, depth + s.radius);
+
+		// Conservative projection of the light box cut to the slice
+		float left   = this->projX * std::min((s.position.x - s.radius) / e0, (s.position.x - s.radius) / e1);
+		float right  = this->projX * std::max((s.position.x + s.radius) / e0, (s.position.x + s.radius) / e1);
+		float bottom = this->projY * std::min((s.position.y - s.radius) / e0, (s.position.y - s.radius) / e1);
+		float top    = this->projY * std::max((s.position.y + s.radius) / e0, (s.position.y + s.radius) / e1);
+		if(right < -1.0f || left > 1.0f || top < -1.0f || bottom > 1.0f)
+			continue;
+
+		Rect rect;
+		rect.light = s.light;
+		rect.x0 = tile(left, sizeX);
+		rect.x1 = tile(right, sizeX);
+		rect.y0 = tile(bottom, sizeY);
+		rect.y1 = tile(top, sizeY);
+		slice.rects.push_back(rect);
+	}
+
+	slice.tiles.assign(sizeX * sizeY, Range { 0, 0 });
+	for(Rect const & rect : slice.rects)
+	{
+		for(int y = rect.y0; y <= rect.y1; y++)
+		{
+			for(int x = rect.x0; x <= rect.x1; x++)
+			{
+				Range & range = slice.tiles[y * sizeX + x];
+				if(range.count < ACKNEXT_CLUSTER_LIGHTS)
+					range.count += 1;
+			}
+		}
+	}
+
+	uint32_t offset = 0;
+	for(Range & range : slice.tiles)
+	{
+		range.offset = offset;
+		offset += range.count;
+		range.count = 0;
+	}
+	slice.indices.resize(offset);
+
+	for(Rect const & rect : slice.rects)
+	{
+		for(int y = rect.y0; y <= rect.y1; y++)
+		{
+			for(int x = rect.x0; x <= rect.x1; x++)
+			{
+				Range & range = slice.tiles[y * sizeX + x];
+				if(range.count < ACKNEXT_CLUSTER_LIGHTS)
+					slice.indices[range.offset + range.count++] = rect.light;
+			}
+		}
+	}
+}
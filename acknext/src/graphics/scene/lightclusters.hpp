@@ -0,0 +1,86 @@
+#ifndef LIGHTCLUSTERS_HPP
+#define LIGHTCLUSTERS_HPP
+
+#include <engine.hpp>
+
+#include <vector>
+#include <stdint.h>
+
+// Sorts lights into a view space froxel grid of screen tiles and
+// exponential depth slices (Forward+). Every cluster stores a range in
+// a compact index list with the lights that touch it. The depth slices
+// are built in parallel on the job system, no GL is involved, the
+// renderer uploads the results.
+class LightClusters
+{
+public:
+	static const int sizeX = ACKNEXT_CLUSTER_X;
+	static const int sizeY = ACKNEXT_CLUSTER_Y;
+	static const int sizeZ = ACKNEXT_CLUSTER_Z;
+	static const int count = sizeX * sizeY * sizeZ;
+
+	// World space bounding sphere of a light
+	struct Sphere
+	{
+		VECTOR position;
+		float radius;
+		uint32_t light; // index stored in the clusters
+	};
+
+	// Lights of a cluster in indices()
+	struct Range
+	{
+		uint32_t offset;
+		uint32_t count;
+	};
+private:
+	struct Rect
+	{
+		uint32_t light;
+		int x0, y0, x1, y1;
+	};
+
+	struct Slice
+	{
+		std::vector<Rect> rects;
+		std::vector<Range> tiles;
+		std::vector<uint32_t> indices;
+		uint32_t offset;
+	};
+private:
+	std::vector<Sphere> spheres; // view space, z is the depth
+	std::vector<Slice> slices;
+	std::vector<Range> clusters;
+	std::vector<uint32_t> indexList;
+	float zNear, zFar;
+	float projX, projY;
+public:
+	LightClusters();
+	NOCOPY(LightClusters);
+	~LightClusters() = default;
+
+	// Clusters are indexed by (z * sizeY + y) * sizeX + x,
+	// tile (0,0) is the lower left corner of the view.
+	void build(
+		MATRIX const & matView,
+		MATRIX const & matProj,
+		float zNear,
+		float zFar,
+		Sphere const * lights,
+		size_t count);
+
+	std::vector<Range> const & ranges() const { return clusters; }
+
+	std::vector<uint32_t> const & indices() const { return indexList; }
+
+	// The depth slice of a view depth is log(depth) * depthScale() + depthBias()
+	float depthScale() const;
+
+	float depthBias() const;
+private:
+	float sliceDepth(int z) const;
+
+	void buildSlice(int z);
+};
+
+#endif // LIGHTCLUSTERS_HPP
@@ -1,4 +1,5 @@
 #include "material.hpp"
+#include "../../virtfs/resourcecache.hpp"
 
 Material::Material(bool userCreated) :
     EngineObject<MATERIAL>(),
@@ -21,6 +22,9 @@ ACKNEXT_API_BLOCK
 
 	void mtl_remove(MATERIAL * _mtl)
 	{
+		if(ResourceCache::release(_mtl)) {
+			return;
+		}
 		Material * mtl = promote<Material>(_mtl);
 		if(mtl && mtl->userCreated) {
 			delete mtl;
@@ -1,4 +1,5 @@
 #include "mesh.hpp"
+#include "../../virtfs/resourcecache.hpp"
 #include <float.h>
 
 
@@ -26,6 +27,9 @@ ACKNEXT_API_BLOCK
 
 	void mesh_remove(MESH * mesh)
 	{
+		if(ResourceCache::release(mesh)) {
+			return;
+		}
 		Mesh * m = promote<Mesh>(mesh);
 		if(m)
 			delete m;
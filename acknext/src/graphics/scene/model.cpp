@@ -7,6 +7,10 @@
 
 #include "../../extensions/extension.hpp"
 
+#include <glm/glm.hpp>
+#include <glm/gtx/matrix_decompose.hpp>
+#include "ackglm.hpp"
+
 static std::unordered_map<std::string, MODEL*> modelCache;
 
 Model::Model() :
@@ -31,6 +35,40 @@ Model::~Model()
 	*/
 }
 
+bool Model::hasSkeleton() const
+{
+	return (api().boneCount > 1) || (api().animationCount > 0);
+}
+
+void Model::updateBones()
+{
+	MODEL const & model = api();
+	size_t count = size_t(model.boneCount);
+
+	this->restPose.resize(count);
+	this->depths.resize(count);
+	for(size_t i = 0; i < count; i++)
+	{
+		glm::vec3 scale;
+		glm::quat rotation;
+		glm::vec3 translation;
+		glm::vec3 skew;
+		glm::vec4 perspective;
+
+		glm::decompose(ack_to_glm(model.bones[i].transform), scale, rotation, translation, skew, perspective);
+
+		FRAME & frame = this->restPose[i];
+		frame.time = 0;
+		glm_to_ack(&frame.position, translation);
+		glm_to_ack(&frame.rotation, glm::conjugate(rotation));
+		glm_to_ack(&frame.scale, scale);
+
+		// Parents come before their children
+		uint8_t parent = model.bones[i].parent;
+		this->depths[i] = (i > 0 && parent < i) ? (this->depths[parent] + 1) : 0;
+	}
+}
+
 ACKNEXT_API_BLOCK
 {
 	MODEL * model_create(int numMeshes, int numBones, int numAnimations)
@@ -62,6 +100,7 @@ ACKNEXT_API_BLOCK
 			mat_id(&api.bones[i].transform);
 			mat_id(&api.bones[i].bindToBoneTransform);
 		}
+		model->updateBones();
 
 		return demote(model);
 	}
@@ -75,6 +114,7 @@ ACKNEXT_API_BLOCK
 
 		// Trivial resize
 		model->boneCount = clamp(boneC, 1, ACKNEXT_MAX_BONES);
+		promote<Model>(model)->updateBones();
 
 		if(meshC != model->meshCount)
 		{
@@ -119,6 +159,24 @@ ACKNEXT_API_BLOCK
 		return Extension::load<MODEL>(file_open_read(fileName));
 	}
 
+	ANIMATION * model_getanimation(MODEL const * model, char const * name)
+	{
+		ARG_NOTNULL(model, nullptr);
+		ARG_NOTNULL(name, nullptr);
+		for(int i = 0; i < model->animationCount; i++)
+		{
+			if(model->animations[i] && strcmp(model->animations[i]->name, name) == 0)
+				return model->animations[i];
+		}
+		return nullptr;
+	}
+
+	void model_updateBones(MODEL * model)
+	{
+		ARG_NOTNULL(model,);
+		promote<Model>(model)->updateBones();
+	}
+
 	void model_updateBoundingBox(MODEL * model, bool updateMeshes)
 	{
 		ARG_NOTNULL(model, );
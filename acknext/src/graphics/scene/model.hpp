@@ -9,10 +9,25 @@ class Model : public EngineObject<MODEL>
 {
 public:
 	bool userCreated;
+private:
+	std::vector<FRAME> restPose;
+	std::vector<uint8_t> depths;
 public:
 	explicit Model();
 	NOCOPY(Model);
 	~Model();
+
+	// Models with a single bone and no animation don't need a pose per entity
+	bool hasSkeleton() const;
+
+	// Rebuilds defaultPose() and boneDepths() from the bones
+	void updateBones();
+
+	// Decomposed bone transforms, one frame per bone
+	FRAME const * defaultPose() const { return restPose.data(); }
+
+	// Number of parents of each bone, the root bone has depth 0
+	uint8_t const * boneDepths() const { return depths.data(); }
 };
 
 #endif // MODEL_HPP
@@ -3,18 +3,22 @@
 #include "mesh.hpp"
 #include "model.hpp"
 #include "camera.hpp"
+#include "drawlist.hpp"
+#include "lightclusters.hpp"
+#include "bonepalette.hpp"
 #include "ackglm.hpp"
 #include "../../scene/entity.hpp"
 #include "../opengl/shader.hpp"
+#include "../opengl/glstate.hpp"
 
 #include "../debug/debugdrawer.hpp"
+#include "../core/gpuprofiler.hpp"
 
 #include <vector>
 #include <algorithm>
-#include <map>
-#include <unordered_map>
 
-#define LIGHT_LIMIT 16
+// lights are cut off when their attenuation falls below this
+#define LIGHT_CUTOFF (1.0 / 512.0)
 
 extern Shader * defaultShader;
 
@@ -24,245 +28,211 @@ Shader * FB(Shader * sh)
 	return defaultShader;
 }
 
+// Three RGBA32F texels per light in texLightData
 struct LIGHTDATA
 {
-	__attribute__((aligned(4))) int type;
-	__attribute__((aligned(4))) float intensity;
-	__attribute__((aligned(4))) float arc;
-	__attribute__((aligned(16))) VECTOR position;
-	__attribute__((aligned(16))) VECTOR direction;
-	__attribute__((aligned(16))) COLOR color;
+	VECTOR position;
+	float type;
+	VECTOR direction;
+	float intensity;
+	VECTOR color;
+	float arc;
 };
 
-static BUFFER * ubo = nullptr;
-static BUFFER * bonesBuf = nullptr;
+// std140 layout of the FrameBlock
+struct FRAMEDATA
+{
+	MATRIX matView;
+	MATRIX matProj;
+	MATRIX matViewProj;
+	VECTOR vecViewPos;
+	float fArc;
+	COLOR vecFogColor;
+	VECTOR4 vecClusterViewport;
+	int vecClusterSize[4];
+	VECTOR2 vecClusterDepth;
+	int iLightCount;
+} __attribute__((aligned(16)));
+
+static BUFFER * frameBuf = nullptr;
 static BUFFER * instaBuf = nullptr;
 
+static BUFFER * paletteBuf = nullptr;
+static GLuint paletteTex;
+
+static BUFFER * lightBuf = nullptr;
+static BUFFER * clusterBuf = nullptr;
+static BUFFER * indexBuf = nullptr;
+static GLuint lightTex, clusterTex, indexTex;
+
+static FRAMEDATA frameData;
+static unsigned int viewStamp = 0;
+
 extern Shader * currentShader;
 
-static void setupLights()
+static void createTextureBuffer(BUFFER ** buffer, GLuint * texture, GLenum format)
 {
-	GLint block_index = glGetUniformBlockIndex(
-		currentShader->api().object,
-		"LightBlock");
-	if(block_index >= 0) // only when lights are required
-	{
-		int lcount = 0;
-		LIGHTDATA * lights = (LIGHTDATA*)glMapNamedBuffer(
-					ubo->object,
-					GL_WRITE_ONLY);
-		for(LIGHT * l = light_next(nullptr); l != nullptr; l = light_next(l))
-		{
-			lights[lcount].type = l->type;
-			lights[lcount].intensity = l->intensity;
-			lights[lcount].arc = cos(0.5 * DEG_TO_RAD * l->arc); // arc is full arc, but cos() is half-arc
-			lights[lcount].position = l->position;
-			lights[lcount].direction = l->direction;
-			lights[lcount].color = l->color;
-
-			vec_normalize(&lights[lcount].direction, 1.0);
-			lcount += 1;
-			if(lcount >= LIGHT_LIMIT) {
-				break;
-			}
-		}
-		glUnmapNamedBuffer(ubo->object);
-
-		GLuint binding_point_index = 2;
-		glBindBufferBase(
-			GL_UNIFORM_BUFFER,
-			binding_point_index,
-			ubo->object);
-		glUniformBlockBinding(
-			currentShader->api().object,
-			block_index,
-			binding_point_index);
-		currentShader->iLightCount = lcount;
-	} else {
-		currentShader->iLightCount = 0;
-	}
+	*buffer = buffer_create(GL_TEXTURE_BUFFER);
+	glCreateTextures(GL_TEXTURE_BUFFER, 1, texture);
+	glTextureBuffer(*texture, format, (*buffer)->object);
 }
 
-static void setupBones()
+template<typename T>
+static void uploadTextureBuffer(BUFFER * buffer, std::vector<T> const & data)
 {
-	GLint block_index = glGetUniformBlockIndex(
-		currentShader->api().object,
-		"BoneBlock");
-	if(block_index >= 0)
-	{
-		GLuint binding_point_index = 4;
-		glBindBufferBase(
-			GL_UNIFORM_BUFFER,
-			binding_point_index,
-			bonesBuf->object);
-		glUniformBlockBinding(
-			currentShader->api().object,
-			block_index,
-			binding_point_index);
-	}
+	// Empty buffer textures are not allowed
+	static T const empty = T();
+	if(data.size() > 0)
+		buffer_set(buffer, sizeof(T) * data.size(), data.data());
+	else
+		buffer_set(buffer, sizeof(T), &empty);
 }
 
-struct Drawcall
+// Fills the frame block and the light clusters once per view and binds them
+static void setupFrame(CAMERA * perspective, MATRIX const & matView, MATRIX const & matProj, MATRIX const & matViewProj)
 {
-	ENTITY const * ent = nullptr;
-	MODEL const * model = nullptr;
-	MESH const * mesh = nullptr;
-	MATERIAL const * material = nullptr;
-	MATRIX matWorld;
-	bool renderDoubleSided;
-
-	Drawcall() = default;
-	Drawcall(Drawcall const &) = default;
-	Drawcall(Drawcall &&) = default;
-	~Drawcall() = default;
+	static std::vector<LIGHTDATA> lights;
+	static std::vector<LightClusters::Sphere> spheres;
+	static LightClusters clusters;
 
-	Drawcall & operator =(Drawcall const &) = default;
-
-	void exec()
+	if(lightBuf == nullptr)
 	{
-		opengl_drawMesh(mesh);
+		createTextureBuffer(&lightBuf, &lightTex, GL_RGBA32F);
+		createTextureBuffer(&clusterBuf, &clusterTex, GL_RG32UI);
+		createTextureBuffer(&indexBuf, &indexTex, GL_R32UI);
 	}
-};
-
-enum class HalfSpace
-{
-	Negative = -1,
-	OnPlane = 0,
-	Positive = 1,
-};
-
-struct Plane
-{
-	Plane() : xyz(0,0,0), w(0) { }
 
-	Plane(float x, float y, float z, float w) :
-	    xyz(x, y, z),
-	    w(w)
+	// Ambient and sun lights affect everything, they come first
+	// and are not clustered.
+	lights.clear();
+	for(int pass = 0; pass < 2; pass++)
 	{
-		this->normalize();
-	}
-
-	glm::vec3 xyz;
-	float w;
-
-	void normalize()
-	{
-		float mag = glm::length(xyz);
-		this->xyz /= mag;
-		this->w   /= mag;
-	}
-
-	float distance(glm::vec3 const & pt) const
-	{
-		return this->xyz.x * pt.x + this->xyz.y * pt.y + this->xyz.z * pt.z + this->w;
+		for(LIGHT * l = light_next(nullptr); l != nullptr; l = light_next(l))
+		{
+			bool global = (l->type == AMBIENTLIGHT || l->type == SUNLIGHT);
+			if(global != (pass == 0))
+				continue;
+
+			LIGHTDATA data;
+			data.position = l->position;
+			data.type = l->type;
+			data.direction = l->direction;
+			data.intensity = l->intensity;
+			data.color = (VECTOR) { l->color.red, l->color.green, l->color.blue };
+			data.arc = cos(0.5 * DEG_TO_RAD * l->arc); // arc is full arc, but cos() is half-arc
+			vec_normalize(&data.direction, 1.0);
+			lights.push_back(data);
+		}
+		if(pass == 0)
+			frameData.vecClusterSize[3] = lights.size();
 	}
 
-	float distance(VECTOR const & pt) const
+	spheres.clear();
+	for(size_t i = frameData.vecClusterSize[3]; i < lights.size(); i++)
 	{
-		return this->xyz.x * pt.x + this->xyz.y * pt.y + this->xyz.z * pt.z + this->w;
+		LightClusters::Sphere sphere;
+		sphere.position = lights[i].position;
+		sphere.radius = lights[i].intensity * sqrt(1.0 / LIGHT_CUTOFF);
+		sphere.light = i;
+		spheres.push_back(sphere);
 	}
 
-	HalfSpace classify(glm::vec3 const & pt) const
-	{
-		float d = this->distance(pt);
-		if (d < 0)
-			return HalfSpace::Negative;
-		if (d > 0)
-			return HalfSpace::Positive;
-		return HalfSpace::OnPlane;
-	}
-};
+	clusters.build(
+		matView,
+		matProj,
+		perspective->zNear,
+		perspective->zFar,
+		spheres.data(),
+		spheres.size());
+
+	uploadTextureBuffer(lightBuf, lights);
+	uploadTextureBuffer(clusterBuf, clusters.ranges());
+	uploadTextureBuffer(indexBuf, clusters.indices());
+
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+
+	static const COLOR fog = {152/255.0,179/255.0,166/255.0,0.0003};
+
+	frameData.matView = matView;
+	frameData.matProj = matProj;
+	frameData.matViewProj = matViewProj;
+	frameData.vecViewPos = perspective->position;
+	frameData.fArc = tan(0.5 * DEG_TO_RAD * perspective->arc);
+	frameData.vecFogColor = fog;
+	frameData.vecClusterViewport = (VECTOR4) {
+		float(viewport[0]),
+		float(viewport[1]),
+		float(LightClusters::sizeX) / std::max(viewport[2], 1),
+		float(LightClusters::sizeY) / std::max(viewport[3], 1) };
+	frameData.vecClusterSize[0] = LightClusters::sizeX;
+	frameData.vecClusterSize[1] = LightClusters::sizeY;
+	frameData.vecClusterSize[2] = LightClusters::sizeZ;
+	frameData.vecClusterDepth = (VECTOR2) { clusters.depthScale(), clusters.depthBias() };
+	frameData.iLightCount = lights.size();
+	buffer_update(frameBuf, 0, sizeof(FRAMEDATA), &frameData);
+
+	GLState::bindUniformBuffer(FRAMEBLOCK_BINDING, frameBuf->object);
+
+	GLState::bindTexture(LIGHTDATA_UNIT, lightTex);
+	GLState::bindTexture(LIGHTCLUSTERS_UNIT, clusterTex);
+	GLState::bindTexture(LIGHTINDICES_UNIT, indexTex);
+
+	viewStamp += 1;
+}
 
-struct Frustrum
+// Animated meshes are skinned, shaders without instancing
+// always skin with the entity pose
+static bool needsBones(Drawgroup const & params)
 {
-	Plane planes[6];
-
-	Frustrum(MATRIX const & modelView)
-	{
-		float m11 = modelView.fields[0][0];
-		float m12 = modelView.fields[1][0];
-		float m13 = modelView.fields[2][0];
-		float m14 = modelView.fields[3][0];
-
-		float m21 = modelView.fields[0][1];
-		float m22 = modelView.fields[1][1];
-		float m23 = modelView.fields[2][1];
-		float m24 = modelView.fields[3][1];
-
-		float m31 = modelView.fields[0][2];
-		float m32 = modelView.fields[1][2];
-		float m33 = modelView.fields[2][2];
-		float m34 = modelView.fields[3][2];
-
-		float m41 = modelView.fields[0][3];
-		float m42 = modelView.fields[1][3];
-		float m43 = modelView.fields[2][3];
-		float m44 = modelView.fields[3][3];
-
-		/*left*/   planes[0] = Plane(m41 + m11, m42 + m12, m43 + m13, m44 + m14);
-		/*right*/  planes[1] = Plane(m41 - m11, m42 - m12, m43 - m13, m44 - m14);
-		/*bottom*/ planes[2] = Plane(m41 + m21, m42 + m22, m43 + m23, m44 + m24);
-		/*top*/    planes[3] = Plane(m41 - m21, m42 - m22, m43 - m23, m44 - m24);
-		/*near*/   planes[4] = Plane(m41 + m31, m42 + m32, m43 + m33, m44 + m34);
-		/*far*/    planes[5] = Plane(m41 - m31, m42 - m32, m43 - m33, m44 - m34);
-
-		for(int i = 0; i < 6; i++)
-			planes[i].normalize();
-	}
-};
+	if(params.mesh->lodMask & ANIMATED)
+		return true;
+	Shader const * shader = FB(promote<Shader>(params.mtl ? params.mtl->shader : nullptr));
+	return !(shader->api().flags & USE_INSTANCING);
+}
 
-static bool cull(Frustrum const & frustrum, VECTOR const & position, float radius)
+// Evaluates the skeletons of all skinned instances into one palette
+static void setupBones(DrawList const & drawlist, BonePalette & palette)
 {
-	using namespace glm;
+	if(paletteBuf == nullptr)
+		createTextureBuffer(&paletteBuf, &paletteTex, GL_RGBA32F);
 
-	var threshold = -radius;
-
-	for(int i = 0; i < 6; i++)
+	palette.clear();
+	for(DrawList::Group const * group : drawlist.queue())
 	{
-		float dist = frustrum.planes[i].distance(position);
-		if(dist < threshold)
-			return true;
+		if(!needsBones(group->params))
+			continue;
+		for(Instance const & inst : group->instances)
+			palette.add(inst.ent);
 	}
-	return false;
-}
+	palette.evaluate();
 
-struct Drawgroup
-{
-	MATERIAL const * mtl = nullptr;
-	MESH const * mesh = nullptr;
-	MODEL const * model = nullptr;
-	bool doublesided = false;
-};
-
-static bool operator ==(Drawgroup const & lhs, Drawgroup const & rhs)
-{
-	return lhs.mtl == rhs.mtl
-		&& lhs.model == rhs.model
-		&& lhs.mesh == rhs.mesh
-		&& lhs.doublesided == rhs.doublesided;
+	uploadTextureBuffer(paletteBuf, palette.data());
+	GLState::bindTexture(BONEPALETTE_UNIT, paletteTex);
 }
 
-class DrawgroupHash
+static bool hasProperties(void const * object)
 {
-public:
-    size_t operator()(const Drawgroup &group) const
-    {
-        size_t h1 = reinterpret_cast<size_t>(group.mtl);
-		size_t h2 = reinterpret_cast<size_t>(group.model);
-        size_t h3 = reinterpret_cast<size_t>(group.mesh);
-		size_t h4 = std::hash<bool>()(group.doublesided);
-        return h1 ^ (h2 << 1) ^ (h3 << 2) ^ (h4 << 3);
-    }
-};
+	Dummy const * dummy = promote<Dummy>(reinterpret_cast<DUMMY const*>(object));
+	return (dummy != nullptr) && (dummy->properties.size() > 0);
+}
 
-struct Instance
+// Shaders that don't use the FrameBlock get the values as plain
+// uniforms, but only once per view.
+static void setupFrameUniforms()
 {
-	// NOTE: MUST BE FIRST MEMBER OF
-	// STRUCT, OTHERWISE THE VERTEX ARRAY LAYOUT
-	// WILL MESS UP!
-	MATRIX transform;
-	ENTITY const * ent = nullptr;
-} __attribute__((packed));
+	if(currentShader->viewStamp == viewStamp)
+		return;
+	currentShader->viewStamp = viewStamp;
+
+	currentShader->matView = frameData.matView;
+	currentShader->matProj = frameData.matProj;
+	currentShader->matViewProj = frameData.matViewProj;
+	currentShader->vecViewPos = frameData.vecViewPos;
+	currentShader->fArc = frameData.fArc;
+	currentShader->vecFogColor = frameData.vecFogColor;
+	currentShader->iLightCount = frameData.iLightCount;
+}
 
 extern GLuint vao;
 
@@ -310,6 +280,18 @@ ACKNEXT_API_BLOCK
 		20000.0,
 	};
 
+	int lod_animintervals[16] =
+	{
+		1, 1, 1, 1, 1, 1, 1, 1,
+		2, 2, 4, 4, 8, 8, 16, 16,
+	};
+
+	int lod_bonedepths[16] =
+	{
+		255, 255, 255, 255, 255, 255, 255, 255,
+		8, 6, 4, 4, 2, 2, 1, 1,
+	};
+
 	void render_scene_with_camera(CAMERA * perspective)
 	{
 		GLint drawFboId = 0;
@@ -409,21 +391,24 @@ ACKNEXT_API_BLOCK
 		if(!fxaa)            fxaa            = create_ppshader("/builtin/shaders/pp/fxaa.frag");
 
 		{ // 1: render scnee
+			GpuProfiler::begin(GpuProfiler::Scene);
 			framebuf_resize(stageScene, targetSize);
 			opengl_setFrameBuffer(stageScene);
 
 			render_scene(perspective, nullptr);
+			GpuProfiler::end(GpuProfiler::Scene);
 		}
 
-		glDisable(GL_CULL_FACE);
-		glDisable(GL_BLEND);
-		glDisable(GL_DEPTH_TEST);
-		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+		GLState::enable(GL_CULL_FACE, false);
+		GLState::enable(GL_BLEND, false);
+		GLState::enable(GL_DEPTH_TEST, false);
+		GLState::polygonMode(GL_FILL);
 
 		BITMAP * currentOutput = stageScene->targets[0];
 
 		if(pp_stages & PP_SSAO)
 		{
+			GpuProfiler::begin(GpuProfiler::SSAO);
 			{
 				framebuf_resize(stageSSAOApply, halfSize);
 				opengl_setFrameBuffer(stageSSAOApply);
@@ -463,10 +448,12 @@ ACKNEXT_API_BLOCK
 			}
 
 			currentOutput = stageSSAOCombine->targets[0];
+			GpuProfiler::end(GpuProfiler::SSAO);
 		}
 
 		if(pp_stages & PP_BLOOM)
 		{
+			GpuProfiler::begin(GpuProfiler::Bloom);
 			{ // 2: render bloom image (half size)
 				framebuf_resize(stageBloom0, halfSize);
 				opengl_setFrameBuffer(stageBloom0);
@@ -505,9 +492,11 @@ ACKNEXT_API_BLOCK
 				opengl_drawFullscreenQuad();
 			}
 			currentOutput = stageBloomCombine->targets[0];
+			GpuProfiler::end(GpuProfiler::Bloom);
 		}
 
 		{ // 4:
+			GpuProfiler::begin(GpuProfiler::Tonemap);
 			framebuf_resize(stageHDR, targetSize);
 			opengl_setFrameBuffer(stageHDR);
 
@@ -521,40 +510,37 @@ ACKNEXT_API_BLOCK
 			currentShader->fExposure = pp_exposure;
 
 			opengl_drawFullscreenQuad();
+			GpuProfiler::end(GpuProfiler::Tonemap);
 		}
 
 		{
+			GpuProfiler::begin(GpuProfiler::FXAA);
 			opengl_setFrameBuffer(nullptr);
 			if(drawFboId != 0)
-				glBindFramebuffer(GL_DRAW_FRAMEBUFFER, drawFboId);
+				GLState::bindDrawFramebuffer(drawFboId);
 
 			opengl_setShader(fxaa);
 
 			currentShader->texInput = stageHDR->targets[0];
 
 			opengl_drawFullscreenQuad();
+			GpuProfiler::end(GpuProfiler::FXAA);
 		}
 	}
 }
 
 static void render_scene(CAMERA * perspective, MATERIAL * mtlOverride)
 {
-	glBindVertexArray(vao);
+	GLState::bindVertexArray(vao);
 
 	if(perspective == nullptr) {
 		return;
 	}
 
-	if(!ubo)
-	{
-		ubo = buffer_create(UNIFORMBUFFER);
-		buffer_set(ubo, sizeof(LIGHTDATA) * LIGHT_LIMIT, nullptr);
-	}
-
-	if(!bonesBuf)
+	if(!frameBuf)
 	{
-		bonesBuf = buffer_create(UNIFORMBUFFER);
-		buffer_set(bonesBuf, sizeof(MATRIX) * ACKNEXT_MAX_BONES, NULL);
+		frameBuf = buffer_create(UNIFORMBUFFER);
+		buffer_set(frameBuf, sizeof(FRAMEDATA), nullptr);
 	}
 
 	if(!instaBuf)
@@ -562,148 +548,66 @@ static void render_scene(CAMERA * perspective, MATERIAL * mtlOverride)
 		instaBuf = buffer_create(VERTEXBUFFER);
 	}
 
-	glEnable(GL_CULL_FACE);
+	GLState::enable(GL_CULL_FACE, true);
 	glCullFace(GL_BACK);
 
-	if(opengl_wireFrame) {
-		glPolygonMode( GL_FRONT_AND_BACK, GL_LINE );
-	} else {
-		glPolygonMode( GL_FRONT_AND_BACK, GL_FILL );
-	}
+	GLState::polygonMode(opengl_wireFrame ? GL_LINE : GL_FILL);
 
-	glEnable(GL_DEPTH_TEST);
+	GLState::enable(GL_DEPTH_TEST, true);
 	glClearColor(sky_color.red, sky_color.green, sky_color.blue, sky_color.alpha);
 	glClearDepth(1.0);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	glDisable(GL_BLEND);
+	GLState::enable(GL_BLEND, false);
 
 	MATRIX matView, matProj;
 	camera_to_matrix(perspective, &matView, &matProj, view_current);
 
-	std::vector<Drawcall> drawcalls;
-
-
 	MATRIX matViewProj;
 	glm_to_ack(&matViewProj,
 		  ack_to_glm(matProj)
 		* ack_to_glm(matView));
 
-	Frustrum clipFrustrum(matViewProj);
-
-	for(ENTITY * ent = ent_next(nullptr); ent != nullptr; ent = ent_next(ent))
-	{
-		// Entity * entity = promote<Entity>(ent);
-		if(ent->model == nullptr)
-			continue;
-		if(!(ent->flags & VISIBLE))
-			continue;
-		// TODO: Filter entity by mask bits
-
-		MATRIX matWorld;
-		glm_to_ack(&matWorld,
-			glm::translate(glm::mat4(), ack_to_glm(ent->position)) *
-			glm::mat4_cast(ack_to_glm(ent->rotation)) *
-			glm::scale(glm::mat4(), ack_to_glm(ent->scale)));
+	setupFrame(perspective, matView, matProj, matViewProj);
 
-		var dist = vec_dist(&camera->position, &ent->position);
-		uint lod;
-		for(lod = 15; lod_distances[lod] > dist && lod > 0; lod--);
+	static DrawList drawlist;
+	drawlist.build(matViewProj, camera->position, mtlOverride);
 
-		if(lod > ent->model->minimumLOD)
-			continue;
+	engine_stats.stateChanges += drawlist.stateChanges();
+	engine_stats.stateChangesAvoided += drawlist.stateChangesAvoided();
 
-		Model * model = promote<Model>(ent->model);
-		for(int i = 0; i < model->api().meshCount; i++)
-		{
-			Drawcall call;
+	static BonePalette palette;
+	setupBones(drawlist, palette);
 
-			if(mtlOverride != nullptr)
-			{
-				call.material = mtlOverride;
-			}
-			else
-			{
-				if(ent->material == nullptr)
-					call.material = model->api().materials[i];
-				else
-					call.material = ent->material;
-			}
-
-			call.matWorld = matWorld;
-			call.model = demote(model);
-			call.mesh = model->api().meshes[i];
-			call.ent = ent;
-			call.renderDoubleSided = !!(call.mesh->lodMask & DOUBLESIDED);
-
-			float radius = 0;
-			radius = glm::max(radius, glm::abs(call.mesh->boundingBox.minimum.x));
-			radius = glm::max(radius, glm::abs(call.mesh->boundingBox.minimum.y));
-			radius = glm::max(radius, glm::abs(call.mesh->boundingBox.minimum.z));
-			radius = glm::max(radius, glm::abs(call.mesh->boundingBox.maximum.x));
-			radius = glm::max(radius, glm::abs(call.mesh->boundingBox.maximum.y));
-			radius = glm::max(radius, glm::abs(call.mesh->boundingBox.maximum.z));
-
-			// Only allow rendering of meshes when the
-			// LOD is enabled in the MESH
-			if(call.mesh->lodMask & (1<<lod))
-			{
-				// And only render it, when the
-				// mesh is actually visible
-				if(!cull(clipFrustrum, call.ent->position, radius))
-				{
-					drawcalls.push_back(call);
-				}
-			}
-		}
-	}
+	static std::vector<Instance> skinned;
 
 	{
-		std::unordered_map<Drawgroup, std::vector<Instance>, DrawgroupHash> groups;
-		for(auto & call : drawcalls)
-		{
-			Drawgroup group;
-			group.mtl = call.material;
-			group.mesh = call.mesh;
-			group.model = call.model;
-			group.doublesided = call.renderDoubleSided;
-
-			Instance instance;
-			instance.ent = call.ent;
-			instance.transform = call.matWorld;
-
-			groups[group].push_back(instance);
-		}
+		// The queue is sorted by state, so only set what changes
+		MATERIAL const * lastMaterial = nullptr;
+		bool overridden = false;
+		int cullMode = -1;
 
 //			engine_log("start rendering");
-		for(auto & entry : groups)
+		for(DrawList::Group const * group : drawlist.queue())
 		{
-			Drawgroup const & params = entry.first;
-			std::vector<Instance> const & instances = entry.second;
+			Drawgroup const & params = group->params;
+			std::vector<Instance> const & instances = group->instances;
 
 			// Setup:
+			// Model and mesh properties may override material
+			// uniforms, then the material has to be set again.
+			if(params.mtl != lastMaterial || overridden)
 			{
 				opengl_setMaterial(params.mtl);
-
-				currentShader->matView = matView;
-				currentShader->matProj = matProj;
-
-				currentShader->vecViewPos = perspective->position;
-				static const COLOR fog = {152/255.0,179/255.0,166/255.0,0.0003};
-				currentShader->vecFogColor = fog;
-				currentShader->fArc = tan(0.5 * DEG_TO_RAD * perspective->arc);
-
-				setupLights();
-				setupBones();
+				setupFrameUniforms();
+				lastMaterial = params.mtl;
 			}
+			overridden = hasProperties(params.model) || hasProperties(params.mesh);
 
 			shader_setUniforms(&currentShader->api(), params.model, false);
 			shader_setUniforms(&currentShader->api(), params.mesh, false);
 
-			// Animated models have a slight problem:
-			// They can't be instanced!
-			bool useInstancing =
-				   (currentShader->api().flags & USE_INSTANCING)
-				&& ((params.mesh->lodMask & ANIMATED) == 0);
+			bool const useBones = needsBones(params);
+			bool const useInstancing = (currentShader->api().flags & USE_INSTANCING);
 
 //				engine_log("Render %5d of (mtl=%p model=%p mesh=%p dsr=%d)%s",
 //					int(instances.size()),
@@ -713,86 +617,55 @@ static void render_scene(CAMERA * perspective, MATERIAL * mtlOverride)
 //					params.doublesided,
 //					(useInstancing) ? " instanced" : "");
 
-			if(params.doublesided)
-				glDisable(GL_CULL_FACE);
-			else
-				glEnable(GL_CULL_FACE);
+			if(int(params.doublesided) != cullMode)
+			{
+				GLState::enable(GL_CULL_FACE, !params.doublesided);
+				cullMode = params.doublesided;
+			}
 
 			if(useInstancing == false)
 			{
 				for(Instance const & inst : instances)
 				{
-					MATRIX animatedBones[ACKNEXT_MAX_BONES];
-					for(int i = 0; i < ACKNEXT_MAX_BONES; i++)
-					{
-						MATRIX & transform = animatedBones[i];
-						mat_id(&transform);
-						mat_translate(&transform, &inst.ent->pose[i].position);
-						mat_rotate(&transform, &inst.ent->pose[i].rotation);
-						mat_scale(&transform, &inst.ent->pose[i].scale);
-					}
-
-					MATRIX transforms[ACKNEXT_MAX_BONES];
-					transforms[0] = animatedBones[0];
-					for(int i = 1; i < inst.ent->model->boneCount; i++)
-					{
-						BONE * bone = &inst.ent->model->bones[i];
-						mat_mul(&transforms[i], &animatedBones[i], &transforms[bone->parent]);
-					}
-
-					MATRIX * boneTrafos = (MATRIX*)buffer_map(bonesBuf, READWRITE);
-					for(int i = 0; i < inst.ent->model->boneCount; i++)
-					{
-						BONE * bone = &inst.ent->model->bones[i];
-						mat_mul(&boneTrafos[i], &bone->bindToBoneTransform, &transforms[i]);
-					}
-					buffer_unmap(bonesBuf);
-
 					currentShader->useInstancing = false;
 					currentShader->useBones = true;
+					currentShader->iBoneOffset = palette.offsetOf(inst.ent);
 					currentShader->matWorld = inst.transform;
 					opengl_drawMesh(params.mesh);
 				}
 			}
 			else
 			{
-				MATRIX transforms[ACKNEXT_MAX_BONES];
-				transforms[0] = params.model->bones[0].transform;
-				for(int i = 1; i < params.model->boneCount; i++)
-				{
-					BONE const * bone = &params.model->bones[i];
-					mat_mul(&transforms[i], &bone->transform, &transforms[bone->parent]);
-				}
+				currentShader->useInstancing = true;
+				currentShader->useBones = useBones;
 
-				MATRIX * boneTrafos = (MATRIX*)buffer_map(bonesBuf, READWRITE);
-				for(int i = 0; i < params.model->boneCount; i++)
+				std::vector<Instance> const * data = &instances;
+				if(useBones)
 				{
-					BONE const * bone = &params.model->bones[i];
-					mat_mul(&boneTrafos[i], &bone->bindToBoneTransform, &transforms[i]);
+					skinned.assign(instances.begin(), instances.end());
+					for(Instance & inst : skinned)
+						inst.bones = palette.offsetOf(inst.ent);
+					data = &skinned;
 				}
-				buffer_unmap(bonesBuf);
-
-				currentShader->useInstancing = true;
-				currentShader->useBones = false;
 
 				// TODO: Implement instance buffer cycling
 				{
-					size_t size = instances.size() * sizeof(Instance);
+					size_t size = data->size() * sizeof(Instance);
 					if(size <= instaBuf->size) {
 						buffer_update(
 							instaBuf,
 							0,
 							size,
-							instances.data());
+							data->data());
 					} else {
 						buffer_set(
 							instaBuf,
 							size,
-							instances.data());
+							data->data());
 					}
 				}
 
-				glVertexArrayVertexBuffer(
+				GLState::vertexBuffer(
 					vao,
 					12,
 					instaBuf->object,
@@ -817,5 +690,7 @@ static void render_scene(CAMERA * perspective, MATERIAL * mtlOverride)
 		}
 	}
 
+	GpuProfiler::begin(GpuProfiler::Debug);
 	DebugDrawer::render(matView, matProj);
+	GpuProfiler::end(GpuProfiler::Debug);
 }
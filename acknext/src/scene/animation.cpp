@@ -1,16 +1,32 @@
 #include "animation.hpp"
 #include <assert.h>
+#include <math.h>
+#include <algorithm>
 
-Channel::Channel(int frameCount)
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+Channel::Channel(int frameCount) :
+    compressed(nullptr)
 {
 	assert(frameCount > 0);
 	api().frameCount = frameCount;
 	api().frames = new FRAME[api().frameCount];
 }
 
+Channel::Channel(CompressedChannel * compressed) :
+    compressed(compressed)
+{
+	assert(compressed != nullptr);
+	api().frameCount = compressed->keyCount();
+	api().frames = nullptr;
+}
+
 Channel::~Channel()
 {
 	delete api().frames;
+	delete this->compressed;
 }
 
 Animation::Animation(char const * name, int channels)
@@ -30,6 +46,140 @@ Animation::~Animation()
 	delete api().channels;
 }
 
+int AnimationSampler::findKey(CHANNEL const * channel, double time, int cursor)
+{
+	FRAME const * frames = channel->frames;
+	int const count = channel->frameCount;
+
+	// Sequential playback stays on the key or moves to the next one
+	if(cursor >= 0 && cursor < count && frames[cursor].time <= time)
+	{
+		if(cursor + 1 >= count || time < frames[cursor + 1].time)
+			return cursor;
+		if(cursor + 2 >= count || time < frames[cursor + 2].time)
+			return cursor + 1;
+	}
+
+	// Seek
+	FRAME const * key = std::upper_bound(
+		frames,
+		frames + count,
+		time,
+		[](double t, FRAME const & frame) { return t < frame.time; });
+	return std::max(int(key - frames) - 1, 0);
+}
+
+// Inline version of lerp() for the sampler
+static inline var mix(var a, var b, float t)
+{
+	return a + t * (b - a);
+}
+
+void AnimationSampler::slerp(QUATERNION & dst, QUATERNION const & a, QUATERNION const & b, float t)
+{
+	float cosine = a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+	float sign = 1.0f;
+	if(cosine < 0.0f) {
+		cosine = -cosine;
+		sign = -1.0f;
+	}
+
+	float wa, wb;
+	if(cosine > 0.9995f) {
+		// Nearly parallel, the normalized lerp is accurate enough
+		wa = 1.0f - t;
+		wb = t;
+	} else {
+		float const theta = acosf(cosine);
+		float const inv = 1.0f / sinf(theta);
+		wa = sinf((1.0f - t) * theta) * inv;
+		wb = sinf(t * theta) * inv;
+	}
+	wb *= sign;
+
+#ifdef __SSE__
+	__m128 q = _mm_add_ps(
+		_mm_mul_ps(_mm_loadu_ps(&a.x), _mm_set1_ps(wa)),
+		_mm_mul_ps(_mm_loadu_ps(&b.x), _mm_set1_ps(wb)));
+	__m128 sq = _mm_mul_ps(q, q);
+	sq = _mm_add_ps(sq, _mm_shuffle_ps(sq, sq, _MM_SHUFFLE(2, 3, 0, 1)));
+	sq = _mm_add_ps(sq, _mm_shuffle_ps(sq, sq, _MM_SHUFFLE(1, 0, 3, 2)));
+	q = _mm_div_ps(q, _mm_sqrt_ps(sq));
+	_mm_storeu_ps(&dst.x, q);
+#else
+	QUATERNION q = {
+		wa * a.x + wb * b.x,
+		wa * a.y + wb * b.y,
+		wa * a.z + wb * b.z,
+		wa * a.w + wb * b.w,
+	};
+	float const len = sqrtf(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+	dst.x = q.x / len;
+	dst.y = q.y / len;
+	dst.z = q.z / len;
+	dst.w = q.w / len;
+#endif
+}
+
+void AnimationSampler::interpolate(FRAME & dst, FRAME const & a, FRAME const & b, float t)
+{
+	dst.time = mix(a.time, b.time, t);
+	dst.position.x = mix(a.position.x, b.position.x, t);
+	dst.position.y = mix(a.position.y, b.position.y, t);
+	dst.position.z = mix(a.position.z, b.position.z, t);
+	slerp(dst.rotation, a.rotation, b.rotation, t);
+	dst.scale.x = mix(a.scale.x, b.scale.x, t);
+	dst.scale.y = mix(a.scale.y, b.scale.y, t);
+	dst.scale.z = mix(a.scale.z, b.scale.z, t);
+}
+
+void AnimationSampler::sample(
+	ANIMATION const * animation,
+	double progress,
+	int * cursors,
+	FRAME * pose,
+	int poseCount,
+	uint8_t const * depths,
+	int maxDepth)
+{
+	if(animation->duration > 0 && (animation->flags & LOOPED))
+		progress = fmod(progress, animation->duration);
+
+	for(int i = 0; i < animation->channelCount; i++)
+	{
+		CHANNEL const * chan = animation->channels[i];
+		assert(chan->frameCount > 0);
+		if(chan->targetBone >= poseCount)
+			continue;
+		if(depths[chan->targetBone] > maxDepth)
+			continue;
+
+		sampleChannel(chan, progress, &cursors[cursorsPerChannel * i], pose[chan->targetBone]);
+	}
+}
+
+void AnimationSampler::sampleChannel(CHANNEL const * chan, double progress, int * cursor, FRAME & dst)
+{
+	CompressedChannel const * compressed = promote<Channel>(chan)->compressed;
+	if(compressed != nullptr) {
+		compressed->sample(progress, cursor, dst);
+		return;
+	}
+
+	int const key = findKey(chan, progress, cursor[0]);
+	cursor[0] = key;
+
+	FRAME const & a = chan->frames[key];
+	if(key + 1 >= chan->frameCount || progress <= a.time) {
+		// Before the first or after the last key
+		dst = a;
+		return;
+	}
+	FRAME const & b = chan->frames[key + 1];
+	float const t = float((progress - a.time) / (b.time - a.time));
+	interpolate(dst, a, b, t);
+}
+
 ACKNEXT_API_BLOCK
 {
 	CHANNEL * chan_create(int frames)
@@ -47,6 +197,15 @@ ACKNEXT_API_BLOCK
 		delete promote<Channel>(chan);
 	}
 
+	FRAME * chan_sample(CHANNEL const * chan, double time, FRAME * frame)
+	{
+		ARG_NOTNULL(chan, nullptr);
+		ARG_NOTNULL(frame, nullptr);
+		int cursors[AnimationSampler::cursorsPerChannel] = { 0 };
+		AnimationSampler::sampleChannel(chan, time, cursors, *frame);
+		return frame;
+	}
+
 	ANIMATION * anim_create(char const * name, int channels)
 	{
 		ARG_NOTNULL(name,nullptr);
@@ -3,10 +3,16 @@
 
 #include <engine.hpp>
 
+#include "keyframes.hpp"
+
 class Channel : public EngineObject<CHANNEL>
 {
+public:
+	// Set for channels loaded in compressed form, frames is NULL then
+	CompressedChannel * compressed;
 public:
 	Channel(int frameCount);
+	explicit Channel(CompressedChannel * compressed);
 	NOCOPY(Channel);
 	~Channel();
 };
@@ -19,4 +25,38 @@ public:
 	~Animation();
 };
 
+// Samples animations into entity poses with interpolation between keys.
+// Does not touch any shared state, so it may run on worker threads.
+class AnimationSampler
+{
+public:
+	AnimationSampler() = delete;
+
+	static const int cursorsPerChannel = CompressedChannel::trackCount;
+
+	// cursors holds the last keys of each channel and is updated, so
+	// sequential playback finds the next key without searching.
+	// It needs cursorsPerChannel entries per channel.
+	// Channels of bones deeper than maxDepth are not sampled.
+	static void sample(
+		ANIMATION const * animation,
+		double progress,
+		int * cursors,
+		FRAME * pose,
+		int poseCount,
+		uint8_t const * depths,
+		int maxDepth);
+
+	// Samples a single channel, cursor holds cursorsPerChannel entries
+	static void sampleChannel(CHANNEL const * chan, double progress, int * cursor, FRAME & dst);
+
+	// Index of the last key at or before time
+	static int findKey(CHANNEL const * channel, double time, int cursor);
+
+	static void interpolate(FRAME & dst, FRAME const & a, FRAME const & b, float t);
+
+	// Spherical interpolation along the shorter arc
+	static void slerp(QUATERNION & dst, QUATERNION const & a, QUATERNION const & b, float t);
+};
+
 #endif // ANIMATION_HPP
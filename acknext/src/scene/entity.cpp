@@ -1,18 +1,24 @@
 #include "entity.hpp"
+#include "animation.hpp"
 #include "../events/event.hpp"
+#include "../graphics/scene/model.hpp"
+#include "../core/jobsystem.hpp"
 
-#include <glm/glm.hpp>
-#include <glm/gtx/matrix_decompose.hpp>
-#include "../graphics/scene/ackglm.hpp"
+#include <math.h>
 
 Entity * Entity::first = nullptr;
 Entity * Entity::last = nullptr;
 
 Entity::Entity() :
-    EngineObject<ENTITY>(),
+    EngineObject<ENTITY>(EntityStorage::allocatePayload()),
     previous(last),
     next(nullptr),
-    hullProvider(nullptr)
+    hullProvider(nullptr),
+    animationCursors(),
+    cursorAnimation(nullptr),
+    boneDepths(nullptr),
+    maxBoneDepth(ACKNEXT_MAX_BONES),
+    handle(EntityStorage::insert(this))
 {
 	// insert
 	if(Entity::first == nullptr) {
@@ -60,6 +66,12 @@ Entity::~Entity()
 
 	// When there is a first entity, there must also be a last entity!
 	assert((Entity::first != nullptr) == (Entity::last != nullptr));
+
+	EntityStorage::remove(this->handle);
+	EntityStorage::freePose(api().pose, api().poseCount);
+
+	// EngineObject does not touch the payload anymore
+	EntityStorage::freePayload(reinterpret_cast<char*>(&api()) - cdataOffset);
 }
 
 void Entity::update()
@@ -69,6 +81,91 @@ void Entity::update()
 		eco->update(eco, demote(this), this->api().ecoData);
 }
 
+bool Entity::refreshTransform()
+{
+	return EntityStorage::refresh(EntityStorage::denseIndex(this->handle));
+}
+
+uint32_t Entity::transformVersion() const
+{
+	return EntityStorage::versions[EntityStorage::denseIndex(this->handle)];
+}
+
+MATRIX const & Entity::worldTransform() const
+{
+	return EntityStorage::transforms[EntityStorage::denseIndex(this->handle)];
+}
+
+var Entity::boundingRadius() const
+{
+	return EntityStorage::radii[EntityStorage::denseIndex(this->handle)];
+}
+
+// Animation LOD from the views of the previous frame. Entities that were
+// drawn before but not in the previous frame are off screen and skipped,
+// entities that were never drawn are always sampled.
+static bool animationDue(Entity * entity)
+{
+	size_t const idx = EntityStorage::denseIndex(entity->handle);
+	entity->maxBoneDepth = ACKNEXT_MAX_BONES;
+	if(EntityStorage::drawnFrames[idx] == 0)
+		return true;
+	if(!EntityStorage::drawnLastFrame(idx))
+		return false;
+
+	int const lod = EntityStorage::lods[idx];
+	entity->maxBoneDepth = lod_bonedepths[lod];
+
+	// The handle spreads the entities of a stage over the frames
+	int const interval = lod_animintervals[lod];
+	return (interval <= 1) || ((uint32_t(total_frames) + entity->handle) % uint32_t(interval)) == 0;
+}
+
+// Validates the arguments, sets up pose and cursors of the entity.
+// Returns nullptr when the entity can't be animated or, with lod set,
+// when the animation LOD skips it this frame.
+static Entity * prepareAnimation(ENTITY * ent, ANIMATION const * animation, bool lod)
+{
+	ARG_NOTNULL(ent, nullptr);
+	ARG_NOTNULL(animation, nullptr);
+
+	MODEL * model = ent->model;
+	if(!model) {
+		engine_seterror(ERR_INVALIDOPERATION, "Cannot animate entity without model!");
+		return nullptr;
+	}
+
+	if(ent->poseCount != model->boneCount)
+		ent_posereset(ent);
+
+	Entity * entity = promote<Entity>(ent);
+	if(entity->cursorAnimation != animation) {
+		entity->cursorAnimation = animation;
+		entity->animationCursors.assign(animation->channelCount * AnimationSampler::cursorsPerChannel, 0);
+	}
+	if(!lod)
+		entity->maxBoneDepth = ACKNEXT_MAX_BONES;
+	else if(!animationDue(entity))
+		return nullptr;
+
+	// Built here, the sampler may run on the worker threads
+	entity->boneDepths = promote<Model>(model)->boneDepths();
+	return entity;
+}
+
+// Thread safe for distinct entities
+static void sampleAnimation(Entity * entity, ANIMATION const * animation, double progress)
+{
+	AnimationSampler::sample(
+		animation,
+		progress,
+		entity->animationCursors.data(),
+		entity->api().pose,
+		entity->api().poseCount,
+		entity->boneDepths,
+		entity->maxBoneDepth);
+}
+
 ACKNEXT_API_BLOCK
 {
 	ENTITY * ent_create(
@@ -161,76 +258,66 @@ ACKNEXT_API_BLOCK
 	ACKFUN void ent_posereset(ENTITY * ent)
 	{
 		ARG_NOTNULL(ent,);
-		if(ent->model)
-		{
-			for(int i = 0; i < ACKNEXT_MAX_BONES; i++)
-			{
-				glm::mat4 mat = ack_to_glm(ent->model->bones[i].transform);
+		Model * model = promote<Model>(ent->model);
 
-				glm::vec3 scale;
-				glm::quat rotation;
-				glm::vec3 translation;
-				glm::vec3 skew;
-				glm::vec4 perspective;
+		int count = 0;
+		if(model != nullptr && model->hasSkeleton())
+			count = ent->model->boneCount;
 
-				glm::decompose(mat, scale, rotation, translation, skew, perspective);
-
-				glm_to_ack(&ent->pose[i].position, translation);
-				glm_to_ack(&ent->pose[i].rotation, glm::conjugate(rotation));
-				glm_to_ack(&ent->pose[i].scale, scale);
-			}
-		} else {
-			static const FRAME id =
-			{
-				time:     0,
-			    position: { 0, 0, 0 },
-			    rotation: { 0, 0, 0, 1},
-			    scale:    { 1, 1, 1 },
-			};
-			for(int i = 0; i < ACKNEXT_MAX_BONES; i++)
-				ent->pose[i] = id;
+		if(count != ent->poseCount)
+		{
+			EntityStorage::freePose(ent->pose, ent->poseCount);
+			ent->pose = (count > 0) ? EntityStorage::allocatePose(count) : nullptr;
+			ent->poseCount = count;
 		}
+		if(count > 0)
+			memcpy(ent->pose, model->defaultPose(), sizeof(FRAME) * count);
 	}
 
 	ACKFUN void ent_animate(ENTITY * ent, char const * animation, double progress)
 	{
-		// TODO: Add interpolation
 		ARG_NOTNULL(ent,);
 		ARG_NOTNULL(animation,);
 
-		MODEL * model = ent->model;
-		if(!model) {
+		if(!ent->model) {
 			engine_seterror(ERR_INVALIDOPERATION, "Cannot animate entity without model!");
 			return;
 		}
 
-		ANIMATION const * anim = nullptr;
-		for(int i = 0; i < model->animationCount; i++)
-		{
-			if(strcmp(model->animations[i]->name, animation) == 0) {
-				anim = model->animations[i];
-				break;
-			}
-		}
+		ANIMATION const * anim = model_getanimation(ent->model, animation);
 		if(!anim) {
 			engine_seterror(ERR_INVALIDOPERATION, "The animation '%s' could not be found!", animation);
 			return;
 		}
+		ent_animateExt(ent, anim, progress);
+	}
 
-		if(anim->duration > 0 && (anim->flags & LOOPED))
-			progress = fmod(progress, anim->duration);
+	ACKFUN void ent_animateExt(ENTITY * ent, ANIMATION const * animation, double progress)
+	{
+		Entity * entity = prepareAnimation(ent, animation, false);
+		if(entity != nullptr)
+			sampleAnimation(entity, animation, progress);
+	}
 
-		for(int i = 0; i < anim->channelCount; i++)
-		{
-			CHANNEL const * chan = anim->channels[i];
-			assert(chan->frameCount > 0);
+	ACKFUN void ent_animate_many(ENTITY * const * ents, ANIMATION const * const * animations, double const * progress, int count)
+	{
+		ARG_NOTNULL(ents,);
+		ARG_NOTNULL(animations,);
+		ARG_NOTNULL(progress,);
+
+		// Poses are allocated from a shared pool, so prepare them first
+		static std::vector<Entity*> entities;
+		entities.resize(maxv(count, 0));
+		for(int i = 0; i < count; i++)
+			entities[i] = prepareAnimation(ents[i], animations[i], true);
 
-			FRAME frame = chan->frames[0];
-			for(int j = 1; j < chan->frameCount; j++) {
-				if(chan->frames[j].time > progress) break;
-				frame = chan->frames[j];
+		JobSystem::parallelFor(entities.size(), 32, [&](size_t begin, size_t end, int)
+		{
+			for(size_t i = begin; i < end; i++)
+			{
+				if(entities[i] != nullptr)
+					sampleAnimation(entities[i], animations[i], progress[i]);
 			}
-			ent->pose[chan->targetBone] = frame;
-		}
+		});
 	}
 }
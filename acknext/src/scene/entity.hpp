@@ -3,6 +3,8 @@
 
 #include <engine.hpp>
 
+#include "entitystorage.hpp"
+
 class Entity : public EngineObject<ENTITY>
 {
 public:
@@ -12,12 +14,36 @@ public:
 	Entity * next;
 public:
 	MODEL * hullProvider;
+	// Last sampled keys per channel of cursorAnimation
+	std::vector<int> animationCursors;
+	ANIMATION const * cursorAnimation;
+	// Bone depths of the model and the limit of the animation LOD stage
+	uint8_t const * boneDepths;
+	int maxBoneDepth;
+public:
+	// Slot in the EntityStorage arrays
+	EntityStorage::Handle const handle;
 public:
 	Entity();
 	NOCOPY(Entity);
 	~Entity();
 
 	void update();
+
+	// Recomputes the cached transform and bounds when
+	// position, rotation, scale or model changed.
+	// Returns true when the cache was updated.
+	bool refreshTransform();
+
+	// Increased each time the transform changes, consumers
+	// compare it against the last version they have seen.
+	uint32_t transformVersion() const;
+
+	// only valid after refreshTransform()
+	MATRIX const & worldTransform() const;
+
+	// radius of the bounding sphere around position, scale included
+	var boundingRadius() const;
 };
 
 #endif // ENTITY_HPP
@@ -0,0 +1,236 @@
+#include "entitystorage.hpp"
+#include "entity.hpp"
+
+#include "../core/jobsystem.hpp"
+#include "../graphics/scene/ackglm.hpp"
+
+// Number of payloads allocated at once
+#define PAYLOAD_SLAB 64
+
+// Number of pose arrays allocated at once per size class
+#define POSE_SLAB 16
+
+// Size classes 1, 2, 4, … ACKNEXT_MAX_BONES
+#define POSE_CLASSES 9
+static_assert((1 << (POSE_CLASSES - 1)) >= ACKNEXT_MAX_BONES, "POSE_CLASSES too small");
+
+std::vector<Entity*> EntityStorage::objects;
+std::vector<VECTOR> EntityStorage::positions;
+std::vector<QUATERNION> EntityStorage::rotations;
+std::vector<VECTOR> EntityStorage::scales;
+std::vector<ENTITYFLAGS> EntityStorage::flags;
+std::vector<MODEL const *> EntityStorage::models;
+std::vector<MATRIX> EntityStorage::transforms;
+std::vector<var> EntityStorage::radii;
+std::vector<uint32_t> EntityStorage::versions;
+std::vector<uint32_t> EntityStorage::drawnFrames;
+std::vector<uint8_t> EntityStorage::lods;
+
+// handle → dense index and back
+static std::vector<uint32_t> sparse;
+static std::vector<EntityStorage::Handle> handles;
+static std::vector<EntityStorage::Handle> freeHandles;
+
+static std::vector<void*> slabs;
+static std::vector<void*> freePayloads;
+
+static std::vector<FRAME*> freePoses[POSE_CLASSES];
+
+static const size_t payloadSize = (Entity::cdataOffset + sizeof(ENTITY) + 15) & ~size_t(15);
+
+EntityStorage::Handle EntityStorage::insert(Entity * entity)
+{
+	Handle handle;
+	if(freeHandles.size() > 0) {
+		handle = freeHandles.back();
+		freeHandles.pop_back();
+	} else {
+		handle = Handle(sparse.size());
+		sparse.push_back(0);
+	}
+
+	sparse[handle] = uint32_t(objects.size());
+	handles.push_back(handle);
+
+	// Scale is never zero, so the first refresh will always hit
+	static const VECTOR zero = { 0, 0, 0 };
+	static const QUATERNION none = { 0, 0, 0, 0 };
+
+	MATRIX id;
+	mat_id(&id);
+
+	objects.push_back(entity);
+	positions.push_back(zero);
+	rotations.push_back(none);
+	scales.push_back(zero);
+	flags.push_back(entity->api().flags);
+	models.push_back(nullptr);
+	transforms.push_back(id);
+	radii.push_back(0);
+	versions.push_back(0);
+	drawnFrames.push_back(0);
+	lods.push_back(0);
+
+	return handle;
+}
+
+template<typename T>
+static void swapRemove(std::vector<T> & list, size_t index)
+{
+	list[index] = list.back();
+	list.pop_back();
+}
+
+void EntityStorage::remove(Handle handle)
+{
+	size_t index = denseIndex(handle);
+	size_t last = objects.size() - 1;
+
+	sparse[handles[last]] = uint32_t(index);
+
+	swapRemove(handles, index);
+	swapRemove(objects, index);
+	swapRemove(positions, index);
+	swapRemove(rotations, index);
+	swapRemove(scales, index);
+	swapRemove(flags, index);
+	swapRemove(models, index);
+	swapRemove(transforms, index);
+	swapRemove(radii, index);
+	swapRemove(versions, index);
+	swapRemove(drawnFrames, index);
+	swapRemove(lods, index);
+
+	freeHandles.push_back(handle);
+}
+
+size_t EntityStorage::denseIndex(Handle handle)
+{
+	assert(handle < sparse.size());
+	return sparse[handle];
+}
+
+bool EntityStorage::refresh(size_t index)
+{
+	ENTITY const & ent = objects[index]->api();
+
+	flags[index] = ent.flags;
+
+	if(memcmp(&ent.position, &positions[index], sizeof(VECTOR)) == 0
+	   && memcmp(&ent.rotation, &rotations[index], sizeof(QUATERNION)) == 0
+	   && memcmp(&ent.scale, &scales[index], sizeof(VECTOR)) == 0
+	   && ent.model == models[index])
+		return false;
+
+	positions[index] = ent.position;
+	rotations[index] = ent.rotation;
+	scales[index] = ent.scale;
+	models[index] = ent.model;
+
+	glm_to_ack(&transforms[index],
+		glm::translate(glm::mat4(), ack_to_glm(ent.position)) *
+		glm::mat4_cast(ack_to_glm(ent.rotation)) *
+		glm::scale(glm::mat4(), ack_to_glm(ent.scale)));
+
+	var radius = 0;
+	if(ent.model != nullptr)
+	{
+		for(int i = 0; i < ent.model->meshCount; i++)
+		{
+			AABB const & box = ent.model->meshes[i]->boundingBox;
+			radius = glm::max(radius, glm::abs(box.minimum.x));
+			radius = glm::max(radius, glm::abs(box.minimum.y));
+			radius = glm::max(radius, glm::abs(box.minimum.z));
+			radius = glm::max(radius, glm::abs(box.maximum.x));
+			radius = glm::max(radius, glm::abs(box.maximum.y));
+			radius = glm::max(radius, glm::abs(box.maximum.z));
+		}
+
+		var maxScale = glm::max(glm::abs(ent.scale.x), glm::max(glm::abs(ent.scale.y), glm::abs(ent.scale.z)));
+		radius *= maxScale;
+	}
+	radii[index] = radius;
+
+	versions[index] += 1;
+	return true;
+}
+
+void EntityStorage::refreshAll()
+{
+	JobSystem::parallelFor(objects.size(), 256, [](size_t begin, size_t end, int)
+	{
+		for(size_t i = begin; i < end; i++)
+			EntityStorage::refresh(i);
+	});
+}
+
+void EntityStorage::markDrawn(size_t index, int lod)
+{
+	uint32_t const frame = uint32_t(total_frames) + 1;
+	if(drawnFrames[index] != frame || lod < lods[index])
+		lods[index] = uint8_t(lod);
+	drawnFrames[index] = frame;
+}
+
+bool EntityStorage::drawnLastFrame(size_t index)
+{
+	// total_frames is increased after rendering
+	return drawnFrames[index] == uint32_t(total_frames);
+}
+
+void * EntityStorage::allocatePayload()
+{
+	if(freePayloads.size() == 0)
+	{
+		char * slab = reinterpret_cast<char*>(malloc(PAYLOAD_SLAB * payloadSize));
+		assert(slab != nullptr);
+		slabs.push_back(slab);
+
+		// reversed, so the slab is handed out front to back
+		for(int i = PAYLOAD_SLAB - 1; i >= 0; i--)
+			freePayloads.push_back(slab + i * payloadSize);
+	}
+	void * payload = freePayloads.back();
+	freePayloads.pop_back();
+	return payload;
+}
+
+void EntityStorage::freePayload(void * payload)
+{
+	// Slabs are kept for the lifetime of the engine,
+	// the next entities will reuse them.
+	freePayloads.push_back(payload);
+}
+
+static int poseClass(int count)
+{
+	int cls = 0;
+	while((1 << cls) < count)
+		cls++;
+	assert(cls < POSE_CLASSES);
+	return cls;
+}
+
+FRAME * EntityStorage::allocatePose(int count)
+{
+	int cls = poseClass(count);
+	std::vector<FRAME*> & list = freePoses[cls];
+	if(list.size() == 0)
+	{
+		size_t frames = size_t(1) << cls;
+		FRAME * slab = reinterpret_cast<FRAME*>(malloc(POSE_SLAB * frames * sizeof(FRAME)));
+		assert(slab != nullptr);
+		slabs.push_back(slab);
+		for(int i = POSE_SLAB - 1; i >= 0; i--)
+			list.push_back(slab + i * frames);
+	}
+	FRAME * pose = list.back();
+	list.pop_back();
+	return pose;
+}
+
+void EntityStorage::freePose(FRAME * pose, int count)
+{
+	if(pose != nullptr)
+		freePoses[poseClass(count)].push_back(pose);
+}
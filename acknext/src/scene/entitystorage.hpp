@@ -0,0 +1,72 @@
+#ifndef ENTITYSTORAGE_HPP
+#define ENTITYSTORAGE_HPP
+
+#include <engine.hpp>
+
+#include <vector>
+
+class Entity;
+
+// Packed per-entity data for the hot loops (culling, collision sync).
+// Entities are addressed by a stable handle which maps to a dense
+// index, removing an entity moves the last one into its place, so
+// [0, size()) is always fully populated.
+// The ENTITY payloads themselves are allocated from slabs, so walking
+// the dense arrays and reading the payloads stays mostly linear.
+class EntityStorage
+{
+public:
+	typedef uint32_t Handle;
+	static const Handle invalid = 0xFFFFFFFF;
+public:
+	// Dense arrays, index with denseIndex(handle) or iterate linearly
+	static std::vector<Entity*> objects;
+	static std::vector<VECTOR> positions;
+	static std::vector<QUATERNION> rotations;
+	static std::vector<VECTOR> scales;
+	static std::vector<ENTITYFLAGS> flags;
+	static std::vector<MODEL const *> models;
+	static std::vector<MATRIX> transforms;
+	static std::vector<var> radii;
+	static std::vector<uint32_t> versions;
+	// Frame the entity was last drawn in plus one, 0 when never drawn
+	static std::vector<uint32_t> drawnFrames;
+	// Nearest LOD stage the entity was drawn with in drawnFrames
+	static std::vector<uint8_t> lods;
+public:
+	EntityStorage() = delete;
+
+	static Handle insert(Entity * entity);
+
+	static void remove(Handle handle);
+
+	static size_t size() { return objects.size(); }
+
+	static size_t denseIndex(Handle handle);
+
+	// Copies the public ENTITY values into the arrays and updates
+	// transform and bounds of the ones that changed.
+	// Returns true when the transform was updated.
+	static bool refresh(size_t index);
+
+	// refresh() for all entities, spread over the job system
+	static void refreshAll();
+
+	// Records that the entity is drawn in a view of the current frame.
+	// Thread safe as long as each index is only marked by one thread.
+	static void markDrawn(size_t index, int lod);
+
+	// True when the entity was drawn in the previous frame
+	static bool drawnLastFrame(size_t index);
+
+	static void * allocatePayload();
+
+	static void freePayload(void * payload);
+
+	// Pose arrays of at least count frames, pooled by power of two sizes
+	static FRAME * allocatePose(int count);
+
+	static void freePose(FRAME * pose, int count);
+};
+
+#endif // ENTITYSTORAGE_HPP
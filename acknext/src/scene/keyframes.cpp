@@ -0,0 +1,319 @@
+#include "keyframes.hpp"
+#include "animation.hpp"
+
+#include <math.h>
+#include <algorithm>
+
+// Largest error allowed when keys are dropped, quantization adds to it
+static const float positionError = 0.001f;
+static const float rotationError = 0.0005f; // radians
+static const float scaleError = 0.001f;
+
+static const float timeSteps = 65535.0f;
+static const float vectorSteps = 65535.0f;
+static const float rotationSteps = 32767.0f;
+
+struct Key
+{
+	float time;
+	float v[4];
+};
+
+static float distance(Key const & a, Key const & b, bool rotation)
+{
+	if(rotation) {
+		float cosine = fabsf(a.v[0] * b.v[0] + a.v[1] * b.v[1] + a.v[2] * b.v[2] + a.v[3] * b.v[3]);
+		return 2.0f * acosf(std::min(cosine, 1.0f));
+	}
+	float d = 0.0f;
+	for(int i = 0; i < 3; i++)
+		d = std::max(d, fabsf(a.v[i] - b.v[i]));
+	return d;
+}
+
+static void interpolate(Key & dst, Key const & a, Key const & b, float t, bool rotation)
+{
+	if(rotation) {
+		QUATERNION qa = { a.v[0], a.v[1], a.v[2], a.v[3] };
+		QUATERNION qb = { b.v[0], b.v[1], b.v[2], b.v[3] };
+		QUATERNION q;
+		AnimationSampler::slerp(q, qa, qb, t);
+		dst.v[0] = q.x;
+		dst.v[1] = q.y;
+		dst.v[2] = q.z;
+		dst.v[3] = q.w;
+	} else {
+		for(int i = 0; i < 3; i++)
+			dst.v[i] = a.v[i] + t * (b.v[i] - a.v[i]);
+	}
+}
+
+// True when all keys between first and last are reproduced by interpolation
+static bool reproducible(std::vector<Key> const & keys, int first, int last, float tolerance, bool rotation)
+{
+	Key const & a = keys[first];
+	Key const & b = keys[last];
+	if(b.time <= a.time)
+		return false;
+	for(int i = first + 1; i < last; i++)
+	{
+		Key approx;
+		interpolate(approx, a, b, (keys[i].time - a.time) / (b.time - a.time), rotation);
+		if(distance(approx, keys[i], rotation) > tolerance)
+			return false;
+	}
+	return true;
+}
+
+// Indices of the keys that have to be stored, empty for a constant track
+static std::vector<int> reduce(std::vector<Key> const & keys, float tolerance, bool rotation)
+{
+	std::vector<int> kept;
+	int const count = keys.size();
+
+	bool constant = true;
+	for(int i = 1; i < count && constant; i++)
+		constant = (distance(keys[0], keys[i], rotation) <= tolerance);
+	if(constant)
+		return kept;
+
+	int first = 0;
+	kept.push_back(first);
+	while(first < count - 1)
+	{
+		int last = first + 1;
+		while(last + 1 < count && reproducible(keys, first, last + 1, tolerance, rotation))
+			last += 1;
+		kept.push_back(last);
+		first = last;
+	}
+	return kept;
+}
+
+static uint16_t quantize(float value, float base, float extent, float steps)
+{
+	if(extent <= 0.0f)
+		return 0;
+	float q = roundf((value - base) / extent * steps);
+	return uint16_t(std::min(std::max(q, 0.0f), steps));
+}
+
+// Rotations are flipped to a positive largest component, which is dropped
+static int smallestThree(Key const & key, float * small)
+{
+	int largest = 0;
+	for(int i = 1; i < 4; i++)
+	{
+		if(fabsf(key.v[i]) > fabsf(key.v[largest]))
+			largest = i;
+	}
+	float const sign = (key.v[largest] < 0.0f) ? -1.0f : 1.0f;
+	for(int i = 0, j = 0; i < 4; i++)
+	{
+		if(i != largest)
+			small[j++] = sign * key.v[i];
+	}
+	return largest;
+}
+
+static void encode(KeyTrack & track, std::vector<Key> const & keys, float tolerance, bool rotation, float start, float length)
+{
+	track.times.clear();
+	track.values.clear();
+	for(int i = 0; i < 3; i++)
+		track.extent[i] = 0.0f;
+
+	std::vector<int> kept;
+	if(length > 0.0f)
+		kept = reduce(keys, tolerance, rotation);
+	if(kept.size() < 2) {
+		for(int i = 0; i < 4; i++)
+			track.base[i] = keys[0].v[i];
+		return;
+	}
+
+	// Component ranges of the stored keys
+	float lo[3] = {  INFINITY,  INFINITY,  INFINITY };
+	float hi[3] = { -INFINITY, -INFINITY, -INFINITY };
+	for(int k : kept)
+	{
+		float small[3];
+		float const * v = keys[k].v;
+		if(rotation) {
+			smallestThree(keys[k], small);
+			v = small;
+		}
+		for(int i = 0; i < 3; i++)
+		{
+			lo[i] = std::min(lo[i], v[i]);
+			hi[i] = std::max(hi[i], v[i]);
+		}
+	}
+	for(int i = 0; i < 3; i++)
+	{
+		track.base[i] = lo[i];
+		track.extent[i] = hi[i] - lo[i];
+	}
+	track.base[3] = 0.0f;
+
+	for(int k : kept)
+	{
+		uint16_t time = quantize(keys[k].time - start, 0.0f, length, timeSteps);
+		if(track.times.size() > 0 && track.times.back() == time) {
+			// Keys closer than the time resolution, the later one wins
+			track.times.pop_back();
+			track.values.resize(track.values.size() - 3);
+		}
+		track.times.push_back(time);
+
+		if(rotation) {
+			float small[3];
+			int largest = smallestThree(keys[k], small);
+			uint16_t q[3];
+			for(int i = 0; i < 3; i++)
+				q[i] = quantize(small[i], track.base[i], track.extent[i], rotationSteps);
+			track.values.push_back(q[0] | ((largest >> 1) << 15));
+			track.values.push_back(q[1] | ((largest & 1) << 15));
+			track.values.push_back(q[2]);
+		} else {
+			for(int i = 0; i < 3; i++)
+				track.values.push_back(quantize(keys[k].v[i], track.base[i], track.extent[i], vectorSteps));
+		}
+	}
+}
+
+int KeyTrack::findKey(float time, int cursor) const
+{
+	int const count = this->times.size();
+
+	// Sequential playback stays on the key or moves to the next one
+	if(cursor >= 0 && cursor < count && this->times[cursor] <= time)
+	{
+		if(cursor + 1 >= count || time < this->times[cursor + 1])
+			return cursor;
+		if(cursor + 2 >= count || time < this->times[cursor + 2])
+			return cursor + 1;
+	}
+
+	auto key = std::upper_bound(
+		this->times.begin(),
+		this->times.end(),
+		time,
+		[](float t, uint16_t k) { return t < k; });
+	return std::max(int(key - this->times.begin()) - 1, 0);
+}
+
+void KeyTrack::decode(int key, VECTOR & dst) const
+{
+	if(this->constant()) {
+		dst = VECTOR { this->base[0], this->base[1], this->base[2] };
+		return;
+	}
+	uint16_t const * q = &this->values[3 * key];
+	dst.x = this->base[0] + this->extent[0] * (q[0] / vectorSteps);
+	dst.y = this->base[1] + this->extent[1] * (q[1] / vectorSteps);
+	dst.z = this->base[2] + this->extent[2] * (q[2] / vectorSteps);
+}
+
+void KeyTrack::decode(int key, QUATERNION & dst) const
+{
+	if(this->constant()) {
+		dst = QUATERNION { this->base[0], this->base[1], this->base[2], this->base[3] };
+		return;
+	}
+	uint16_t const * q = &this->values[3 * key];
+	int const largest = ((q[0] >> 15) << 1) | (q[1] >> 15);
+
+	float small[3];
+	for(int i = 0; i < 3; i++)
+		small[i] = this->base[i] + this->extent[i] * ((q[i] & 0x7FFF) / rotationSteps);
+	float const rest = 1.0f - small[0] * small[0] - small[1] * small[1] - small[2] * small[2];
+
+	float * v = &dst.x;
+	for(int i = 0, j = 0; i < 4; i++)
+		v[i] = (i == largest) ? sqrtf(std::max(rest, 0.0f)) : small[j++];
+}
+
+static inline void blend(VECTOR & dst, VECTOR const & a, VECTOR const & b, float t)
+{
+	dst.x = a.x + t * (b.x - a.x);
+	dst.y = a.y + t * (b.y - a.y);
+	dst.z = a.z + t * (b.z - a.z);
+}
+
+static inline void blend(QUATERNION & dst, QUATERNION const & a, QUATERNION const & b, float t)
+{
+	AnimationSampler::slerp(dst, a, b, t);
+}
+
+template<typename T>
+static void sampleTrack(KeyTrack const & track, float time, int & cursor, T & dst)
+{
+	if(track.constant()) {
+		track.decode(0, dst);
+		return;
+	}
+
+	int const key = track.findKey(time, cursor);
+	cursor = key;
+
+	if(key + 1 >= int(track.times.size()) || time <= track.times[key]) {
+		// Before the first or after the last key
+		track.decode(key, dst);
+		return;
+	}
+	T a, b;
+	track.decode(key, a);
+	track.decode(key + 1, b);
+	blend(dst, a, b, (time - track.times[key]) / float(track.times[key + 1] - track.times[key]));
+}
+
+CompressedChannel::CompressedChannel() :
+    start(0), length(0),
+    position(), rotation(), scale()
+{
+
+}
+
+void CompressedChannel::compress(CHANNEL const * channel)
+{
+	assert(channel->frameCount > 0);
+	FRAME const * frames = channel->frames;
+	int const count = channel->frameCount;
+
+	this->start = frames[0].time;
+	this->length = frames[count - 1].time - this->start;
+
+	std::vector<Key> positions(count), rotations(count), scales(count);
+	for(int i = 0; i < count; i++)
+	{
+		FRAME const & frame = frames[i];
+		positions[i] = Key { frame.time, { frame.position.x, frame.position.y, frame.position.z, 0.0f } };
+		rotations[i] = Key { frame.time, { frame.rotation.x, frame.rotation.y, frame.rotation.z, frame.rotation.w } };
+		scales[i] = Key { frame.time, { frame.scale.x, frame.scale.y, frame.scale.z, 0.0f } };
+	}
+
+	encode(this->position, positions, positionError, false, this->start, this->length);
+	encode(this->rotation, rotations, rotationError, true, this->start, this->length);
+	encode(this->scale, scales, scaleError, false, this->start, this->length);
+}
+
+int CompressedChannel::keyCount() const
+{
+	size_t count = std::max(
+		std::max(this->position.times.size(), this->rotation.times.size()),
+		this->scale.times.size());
+	return std::max(int(count), 1);
+}
+
+void CompressedChannel::sample(double time, int * cursors, FRAME & dst) const
+{
+	float t = 0.0f;
+	if(this->length > 0.0f)
+		t = float((time - this->start) / this->length) * timeSteps;
+
+	dst.time = time;
+	sampleTrack(this->position, t, cursors[0], dst.position);
+	sampleTrack(this->rotation, t, cursors[1], dst.rotation);
+	sampleTrack(this->scale, t, cursors[2], dst.scale);
+}
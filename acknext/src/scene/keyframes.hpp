@@ -0,0 +1,58 @@
+#ifndef KEYFRAMES_HPP
+#define KEYFRAMES_HPP
+
+#include <engine.hpp>
+
+#include <vector>
+#include <stdint.h>
+
+// Quantized keys of one part of a channel (position, rotation or scale).
+// A track without keys is constant and base holds the value. Otherwise
+// every key stores three 16 bit components in [base, base + extent].
+// Rotations use the smallest three encoding: 15 bits per component and
+// the index of the dropped largest component in the top bits.
+struct KeyTrack
+{
+	float base[4];
+	float extent[3];
+	std::vector<uint16_t> times;  // normalized to the channel time range
+	std::vector<uint16_t> values; // 3 per key
+
+	bool constant() const { return times.empty(); }
+
+	// Index of the last key at or before the normalized time
+	int findKey(float time, int cursor) const;
+
+	void decode(int key, VECTOR & dst) const;
+
+	void decode(int key, QUATERNION & dst) const;
+};
+
+// Channel in the compressed form it is stored in the model file.
+class CompressedChannel
+{
+public:
+	static const int trackCount = 3;
+
+	float start;  // time of the first key
+	float length; // time range covered by the keys
+	KeyTrack position;
+	KeyTrack rotation;
+	KeyTrack scale;
+public:
+	CompressedChannel();
+	NOCOPY(CompressedChannel);
+	~CompressedChannel() = default;
+
+	// Drops constant tracks and keys that interpolation reproduces
+	// within the error bounds, then quantizes the remaining keys.
+	void compress(CHANNEL const * channel);
+
+	// Largest number of keys in a track
+	int keyCount() const;
+
+	// cursors holds trackCount entries
+	void sample(double time, int * cursors, FRAME & dst) const;
+};
+
+#endif // KEYFRAMES_HPP
@@ -6,6 +6,105 @@
 
 #include "../graphics/core/glenum-translator.hpp"
 #include "../extensions/extension.hpp"
+#include "../scene/animation.hpp"
+
+// True when the file still has size bytes left, files of unknown size pass
+static bool canRead(ACKFILE * file, uint64_t size)
+{
+	int64_t total = file_size(file);
+	int64_t position = file_tell(file);
+	if(total < 0 || position < 0)
+		return true;
+	return (position <= total) && (uint64_t(total - position) >= size);
+}
+
+static void writeTrack(ACKFILE * file, KeyTrack const & track, int components)
+{
+	file_write_uint32(file, track.times.size());
+	if(track.constant()) {
+		for(int i = 0; i < components; i++)
+			file_write_float(file, track.base[i]);
+		return;
+	}
+	for(int i = 0; i < 3; i++)
+	{
+		file_write_float(file, track.base[i]);
+		file_write_float(file, track.extent[i]);
+	}
+	file_write(file, track.times.data(), sizeof(uint16_t) * track.times.size());
+	file_write(file, track.values.data(), sizeof(uint16_t) * track.values.size());
+}
+
+// Returns false when the file ends before the track data
+static bool readTrack(ACKFILE * file, KeyTrack & track, int components)
+{
+	if(!canRead(file, sizeof(uint32_t)))
+		return false;
+	uint32_t count = file_read_uint32(file);
+	track.base[3] = 0.0f;
+	if(count == 0) {
+		if(!canRead(file, sizeof(float) * components))
+			return false;
+		for(int i = 0; i < components; i++)
+			track.base[i] = file_read_float(file);
+		return true;
+	}
+
+	// Key times are 16 bit, so there can't be more keys than that
+	uint64_t const size = uint64_t(count) * 4 * sizeof(uint16_t);
+	if(count > 65536 || !canRead(file, 6 * sizeof(float) + size))
+		return false;
+	for(int i = 0; i < 3; i++)
+	{
+		track.base[i] = file_read_float(file);
+		track.extent[i] = file_read_float(file);
+	}
+	track.times.resize(count);
+	track.values.resize(3 * count);
+	uint32_t const timeSize = sizeof(uint16_t) * track.times.size();
+	uint32_t const valueSize = sizeof(uint16_t) * track.values.size();
+	return file_read(file, track.times.data(), timeSize) == int64_t(timeSize)
+		&& file_read(file, track.values.data(), valueSize) == int64_t(valueSize);
+}
+
+// Channels are always stored compressed, plain ones are compressed here
+static void writeChannel(ACKFILE * file, CHANNEL const * chan)
+{
+	CompressedChannel temp;
+	CompressedChannel const * compressed = promote<Channel>(chan)->compressed;
+	if(compressed == nullptr) {
+		temp.compress(chan);
+		compressed = &temp;
+	}
+	file_write_uint8(file, chan->targetBone);
+	file_write_float(file, compressed->start);
+	file_write_float(file, compressed->length);
+	writeTrack(file, compressed->position, 3);
+	writeTrack(file, compressed->rotation, 4);
+	writeTrack(file, compressed->scale, 3);
+}
+
+// Returns nullptr when the channel data is truncated
+static CHANNEL * readChannel(ACKFILE * file)
+{
+	if(!canRead(file, sizeof(uint8_t) + 2 * sizeof(float)))
+		return nullptr;
+	uint8_t bone = file_read_uint8(file);
+	CompressedChannel * compressed = new CompressedChannel();
+	compressed->start = file_read_float(file);
+	compressed->length = file_read_float(file);
+	bool valid = readTrack(file, compressed->position, 3)
+		&& readTrack(file, compressed->rotation, 4)
+		&& readTrack(file, compressed->scale, 3);
+	if(!valid) {
+		delete compressed;
+		return nullptr;
+	}
+
+	CHANNEL * chan = demote(new Channel(compressed));
+	chan->targetBone = bone;
+	return chan;
+}
 
 ACKNEXT_API_BLOCK
 {
@@ -16,8 +115,9 @@ ACKNEXT_API_BLOCK
 
 	void model_write(ACKFILE * file, MODEL const * model)
 	{
-		Extension::writeHeader(file, TYPE_MODEL, acff_guidModel);
+		Extension::writeHeader(file, TYPE_MODEL, acff_guidModelCompressed);
 
+		file_write_uint32(file, ACFF_ANIMATION_VERSION);
 		file_write_uint32(file, model->boneCount);
 		file_write_uint32(file, model->meshCount);
 		file_write_uint32(file, model->animationCount);
@@ -54,17 +154,7 @@ ACKNEXT_API_BLOCK
 			file_write_uint32(file, anim->channelCount);
 			for(int i = 0; i < anim->channelCount; i++)
 			{
-				CHANNEL const * chan = anim->channels[i];
-				file_write_uint8(file, chan->targetBone);
-				file_write_uint32(file, chan->frameCount);
-				for(int i = 0; i < chan->frameCount; i++)
-				{
-					FRAME const & frame = chan->frames[i];
-					file_write_float(file, frame.time);
-					file_write_vector(file, frame.position);
-					file_write_quat(file, frame.rotation);
-					file_write_vector(file, frame.scale);
-				}
+				writeChannel(file, anim->channels[i]);
 			}
 		}
 	}
@@ -78,7 +168,7 @@ ACKNEXT_API_BLOCK
 
 	void mesh_write(ACKFILE * file, MESH const * mesh)
 	{
-		Extension::writeHeader(file, TYPE_MESH, acff_guidMesh);
+		Extension::writeHeader(file, TYPE_MESH, acff_guidMeshPacked);
 
 		int indexCount = 0;
 		int vertexCount = 0;
@@ -90,31 +180,23 @@ ACKNEXT_API_BLOCK
 			vertexCount = mesh->vertexBuffer->size / sizeof(VERTEX);
 		}
 
+		file_write_uint32(file, ACFF_MESH_VERSION);
+		file_write_uint32(file, sizeof(INDEX));
+		file_write_uint32(file, sizeof(VERTEX));
 		file_write_uint32(file, mesh->primitiveType);
 		file_write_uint32(file, indexCount);
 		file_write_uint32(file, vertexCount);
 		file_write_uint32(file, mesh->lodMask);
 		if(mesh->indexBuffer)
 		{
-			INDEX * indices = (INDEX*)buffer_map(mesh->indexBuffer, GL_READ_ONLY);
-			for(int i = 0; i < indexCount; i++) {
-				file_write_uint32(file, indices[i]);
-			}
+			void * indices = buffer_map(mesh->indexBuffer, GL_READ_ONLY);
+			file_write(file, indices, indexCount * sizeof(INDEX));
 			buffer_unmap(mesh->indexBuffer);
 		}
 		if(mesh->vertexBuffer)
 		{
-			VERTEX * vertices = (VERTEX*)buffer_map(mesh->vertexBuffer, GL_READ_ONLY);
-			for(int i = 0; i < vertexCount; i++) {
-				file_write_vector(file, vertices[i].position);
-				file_write_vector(file, vertices[i].normal);
-				file_write_vector(file, vertices[i].tangent);
-				file_write_color(file, vertices[i].color);
-				file_write_uv(file, vertices[i].texcoord0);
-				file_write_uv(file, vertices[i].texcoord1);
-				file_write(file, vertices[i].bones.values, 4);
-				file_write(file, vertices[i].boneWeights.values, 4);
-			}
+			void * vertices = buffer_map(mesh->vertexBuffer, GL_READ_ONLY);
+			file_write(file, vertices, vertexCount * sizeof(VERTEX));
 			buffer_unmap(mesh->vertexBuffer);
 		}
 	}
@@ -263,9 +345,111 @@ ACKNEXT_API_BLOCK
 	}
 }
 
+static void removeAnimation(ANIMATION * anim)
+{
+	for(int i = 0; i < anim->channelCount; i++)
+	{
+		if(anim->channels[i] != nullptr)
+			chan_remove(anim->channels[i]);
+	}
+	anim_remove(anim);
+}
+
+// Returns nullptr when the animation data is truncated or invalid
+static ANIMATION * readAnimation(ACKFILE * file, bool compressed)
+{
+	if(!canRead(file, sizeof(uint32_t)))
+		return nullptr;
+	uint32_t length = file_read_uint32(file);
+	if(length == 0 || length >= sizeof(ANIMATION::name) || !canRead(file, length + sizeof(float) + 2 * sizeof(uint32_t)))
+		return nullptr;
+	char name[sizeof(ANIMATION::name)] = { 0 };
+	if(file_read(file, name, length) != int64_t(length))
+		return nullptr;
+	var duration = file_read_float(file);
+	uint32_t flags = file_read_uint32(file);
+	uint32_t chancnt = file_read_uint32(file);
+
+	// Every channel stores at least its bone and a key count
+	if(chancnt == 0 || chancnt > INT32_MAX || !canRead(file, uint64_t(chancnt) * 5))
+		return nullptr;
+
+	// Also rejects names that start with a zero byte
+	ANIMATION * anim = anim_create(name, chancnt);
+	if(anim == nullptr)
+		return nullptr;
+	anim->duration = duration;
+	anim->flags = flags;
+
+	for(int i = 0; i < anim->channelCount; i++)
+	{
+		if(compressed) {
+			anim->channels[i] = readChannel(file);
+			if(anim->channels[i] == nullptr) {
+				removeAnimation(anim);
+				return nullptr;
+			}
+			continue;
+		}
+
+		if(!canRead(file, sizeof(uint8_t) + sizeof(uint32_t))) {
+			removeAnimation(anim);
+			return nullptr;
+		}
+		uint8_t bone = file_read_uint8(file);
+		uint32_t frameCount = file_read_uint32(file);
+
+		// time, position, rotation and scale
+		uint64_t const frameSize = 11 * sizeof(float);
+		if(frameCount == 0 || frameCount > INT32_MAX || !canRead(file, frameCount * frameSize)) {
+			removeAnimation(anim);
+			return nullptr;
+		}
+
+		CHANNEL * chan = chan_create(frameCount);
+		chan->targetBone = bone;
+
+		for(int i = 0; i < chan->frameCount; i++)
+		{
+			FRAME & frame = chan->frames[i];
+			frame.time = file_read_float(file);
+			frame.position = file_read_vector(file);
+			frame.rotation = file_read_quat(file);
+			frame.scale = file_read_vector(file);
+		}
+
+		anim->channels[i] = chan;
+	}
+	return anim;
+}
+
+// Removes a partially loaded model with its first meshCount meshes and
+// materials and its first animCount animations
+static void removeModel(MODEL * model, uint meshCount, uint animCount)
+{
+	for(uint i = 0; i < meshCount; i++)
+	{
+		mesh_remove(model->meshes[i]);
+		if(model->materials[i] != nullptr)
+			mtl_remove(model->materials[i]);
+	}
+	for(uint i = 0; i < animCount; i++)
+		removeAnimation(model->animations[i]);
+	model_remove(model);
+}
+
 MODEL * loadModel(ACKFILE * file, ACKGUID const * guid)
 {
-	assert(guid_compare(guid, &acff_guidModel));
+	bool compressed = guid_compare(guid, &acff_guidModelCompressed);
+	assert(compressed || guid_compare(guid, &acff_guidModel));
+
+	if(compressed) {
+		uint32_t version = file_read_uint32(file);
+		if(version != ACFF_ANIMATION_VERSION) {
+			engine_seterror(ERR_INVALIDOPERATION, "Unsupported animation layout version %d!", version);
+			return nullptr;
+		}
+	}
 
 	uint32_t boneCount = file_read_uint32(file);
 	uint32_t meshCount = file_read_uint32(file);
@@ -283,10 +467,15 @@ MODEL * loadModel(ACKFILE * file, ACKGUID const * guid)
 		dst.transform = file_read_matrix(file);
 		dst.bindToBoneTransform = file_read_matrix(file);
 	}
+	model_updateBones(result);
 
 	for(uint i = 0; i < meshCount; i++)
 	{
 		result->meshes[i] = Extension::load<MESH>(file);
+		if(result->meshes[i] == nullptr) {
+			removeModel(result, i, 0);
+			return nullptr;
+		}
 	}
 	for(uint i = 0; i < meshCount; i++)
 	{
@@ -295,36 +484,13 @@ MODEL * loadModel(ACKFILE * file, ACKGUID const * guid)
 
 	for(uint i = 0; i < animationCount; i++)
 	{
-		char * name = file_read_string(file, 0);
-		var duration = file_read_float(file);
-		uint32_t flags = file_read_uint32(file);
-		uint32_t chancnt = file_read_uint32(file);
-
-		ANIMATION * anim = anim_create(name, chancnt);
-		anim->duration = duration;
-		anim->flags = flags;
-
-		for(int i = 0; i < anim->channelCount; i++)
-		{
-			uint8_t bone = file_read_uint8(file);
-			uint32_t frameCount = file_read_uint32(file);
-
-			CHANNEL * chan = chan_create(frameCount);
-			chan->targetBone = bone;
-
-			for(int i = 0; i < chan->frameCount; i++)
-			{
-				FRAME & frame = chan->frames[i];
-				frame.time = file_read_float(file);
-				frame.position = file_read_vector(file);
-				frame.rotation = file_read_quat(file);
-				frame.scale = file_read_vector(file);
-			}
-
-			anim->channels[i] = chan;
+		ANIMATION * anim = readAnimation(file, compressed);
+		if(anim == nullptr) {
+			engine_seterror(ERR_FILESYSTEM, "Invalid or truncated animation data!");
+			removeModel(result, meshCount, i);
+			return nullptr;
 		}
 		result->animations[i] = anim;
-		free(name);
 	}
 
 	model_updateBoundingBox(result, true);
@@ -332,10 +498,9 @@ MODEL * loadModel(ACKFILE * file, ACKGUID const * guid)
 	return result;
 }
 
-static MESH * loadMesh(ACKFILE * file, ACKGUID const * guid)
+// Old meshes, stored element by element
+static MESH * loadMeshLegacy(ACKFILE * file)
 {
-	assert(guid_compare(guid, &acff_guidMesh));
-
 	GLenum primitiveType = file_read_uint32(file);
 	uint32_t indexCount  = file_read_uint32(file);
 	uint32_t vertexCount = file_read_uint32(file);
@@ -381,6 +546,77 @@ static MESH * loadMesh(ACKFILE * file, ACKGUID const * guid)
 	return result;
 }
 
+// Fills the buffer straight from the file: directly from the
+// file contents if they are mapped, else with a single read
+// into the mapped buffer.
+// Returns nullptr when the file ends before the buffer data
+static BUFFER * loadBufferData(ACKFILE * file, GLenum type, uint64_t size)
+{
+	if(size > UINT32_MAX || !canRead(file, size)) {
+		engine_seterror(ERR_FILESYSTEM, "Unexpected end of mesh data!");
+		return nullptr;
+	}
+
+	BUFFER * buffer = buffer_create(type);
+	void const * data = file_view(file, size);
+	if(data != nullptr) {
+		buffer_set(buffer, size, data);
+	} else {
+		buffer_set(buffer, size, nullptr);
+		void * dst = buffer_map(buffer, WRITEONLY);
+		int64_t len = file_read(file, dst, size);
+		buffer_unmap(buffer);
+		if(len != int64_t(size)) {
+			engine_seterror(ERR_FILESYSTEM, "Unexpected end of mesh data!");
+			buffer_remove(buffer);
+			return nullptr;
+		}
+	}
+	return buffer;
+}
+
+static MESH * loadMesh(ACKFILE * file, ACKGUID const * guid)
+{
+	if(guid_compare(guid, &acff_guidMesh)) {
+		return loadMeshLegacy(file);
+	}
+	assert(guid_compare(guid, &acff_guidMeshPacked));
+
+	uint32_t version     = file_read_uint32(file);
+	uint32_t indexSize   = file_read_uint32(file);
+	uint32_t vertexSize  = file_read_uint32(file);
+	if(version != ACFF_MESH_VERSION || indexSize != sizeof(INDEX) || vertexSize != sizeof(VERTEX)) {
+		engine_seterror(ERR_INVALIDOPERATION, "Unsupported mesh layout version %d!", version);
+		return nullptr;
+	}
+
+	GLenum primitiveType = file_read_uint32(file);
+	uint32_t indexCount  = file_read_uint32(file);
+	uint32_t vertexCount = file_read_uint32(file);
+	uint32_t lodmask     = file_read_uint32(file);
+
+	BUFFER * vertexBuffer = nullptr;
+	BUFFER * indexBuffer = nullptr;
+
+	if(indexCount > 0) {
+		indexBuffer = loadBufferData(file, INDEXBUFFER, uint64_t(indexCount) * sizeof(INDEX));
+		if(indexBuffer == nullptr)
+			return nullptr;
+	}
+	if(vertexCount > 0) {
+		vertexBuffer = loadBufferData(file, VERTEXBUFFER, uint64_t(vertexCount) * sizeof(VERTEX));
+		if(vertexBuffer == nullptr) {
+			buffer_remove(indexBuffer);
+			return nullptr;
+		}
+	}
+
+	MESH * result = mesh_create(primitiveType, vertexBuffer, indexBuffer);
+	mesh_updateBoundingBox(result);
+	result->lodMask = lodmask;
+	return result;
+}
+
 static MATERIAL * loadMaterial(ACKFILE * file, ACKGUID const * guid)
 {
 	assert(guid_compare(guid, &acff_guidMaterial));
@@ -514,7 +750,9 @@ EXTENSION acknextDefaultSerializers =
 		if(guid_compare(guid, &acff_guidBitmap)) return TYPE_BITMAP;
         if(guid_compare(guid, &acff_guidMaterial)) return TYPE_MATERIAL;
         if(guid_compare(guid, &acff_guidMesh)) return TYPE_MESH;
+        if(guid_compare(guid, &acff_guidMeshPacked)) return TYPE_MESH;
         if(guid_compare(guid, &acff_guidModel)) return TYPE_MODEL;
+        if(guid_compare(guid, &acff_guidModelCompressed)) return TYPE_MODEL;
         if(guid_compare(guid, &acff_guidShader)) return TYPE_SHADER;
         return TYPE_INVALID;
     },
@@ -3,6 +3,9 @@
 #include "core/config.hpp"
 #include <physfs.h>
 
+#include <stdio.h>
+#include <sys/mman.h>
+
 struct ackfile
 {
 public:
@@ -21,6 +24,9 @@ public:
 	virtual int64_t size() { return -1; } // Default is: "not implemented"
 
 	virtual void flush() { } // Default: do nothing
+
+	// Pointer to the next size bytes, skips them. Default: not in memory
+	virtual void const * view(uint32_t size) { (void)size; return nullptr; }
 };
 
 struct physfile : public ackfile
@@ -28,17 +34,21 @@ struct physfile : public ackfile
 private:
 	FILE * file;
 	size_t length;
+	void * mapping;
 public:
 	physfile(FILE * file) :
-	    file(file)
+	    file(file),
+	    mapping(nullptr)
 	{
-		fseek(this->file, SEEK_END, 0);
+		fseek(this->file, 0, SEEK_END);
 		this->length = ftell(this->file);
-		fseek(this->file, SEEK_SET, 0);
+		fseek(this->file, 0, SEEK_SET);
 	}
 
 	~physfile()
 	{
+		if(this->mapping != nullptr)
+			munmap(this->mapping, this->length);
 		fclose(this->file);
 	}
 
@@ -54,7 +64,7 @@ public:
 
 	virtual void seek(uint64_t position) override
 	{
-		fseek(this->file, SEEK_SET, position);
+		fseek(this->file, long(position), SEEK_SET);
 	}
 
 	virtual bool eof() override
@@ -76,6 +86,22 @@ public:
 	{
 		fflush(this->file);
 	}
+
+	virtual void const * view(uint32_t size) override
+	{
+		int64_t position = this->tell();
+		if(position < 0 || uint64_t(position) + size > this->length)
+			return nullptr;
+		if(this->mapping == nullptr)
+		{
+			void * mem = mmap(nullptr, this->length, PROT_READ, MAP_PRIVATE, fileno(this->file), 0);
+			if(mem == MAP_FAILED)
+				return nullptr;
+			this->mapping = mem;
+		}
+		this->seek(uint64_t(position) + size);
+		return static_cast<uint8_t const *>(this->mapping) + position;
+	}
 };
 
 struct virtfile : public ackfile
@@ -196,6 +222,15 @@ public:
 	{
 		// EASY MODE!
 	}
+
+	virtual void const * view(uint32_t size) override
+	{
+		if(this->pointer + size > this->blob->size)
+			return nullptr;
+		void const * data = this->dataPtr();
+		this->pointer += size;
+		return data;
+	}
 private:
 	int64_t calcActualLength(int64_t size) const
 	{
@@ -329,6 +364,12 @@ ACKNEXT_API_BLOCK
 		file->flush();
 	}
 
+	void const * file_view(ACKFILE * file, uint32_t size)
+	{
+		ARG_NOTNULL(file, nullptr);
+		return file->view(size);
+	}
+
 	void file_close(ACKFILE * file)
 	{
 		ARG_NOTNULL(file,);
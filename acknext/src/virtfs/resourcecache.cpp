@@ -0,0 +1,201 @@
+#include "resourcecache.hpp"
+
+#include <list>
+#include <string>
+#include <unordered_map>
+
+struct CacheEntry;
+
+typedef std::list<CacheEntry*> IdleList;
+
+struct CacheEntry
+{
+	ACKTYPE type;
+	std::string path;
+	void * object;
+	size_t bytes;
+	int references;
+	IdleList::iterator idle; // valid when references is 0
+};
+
+struct CachePool
+{
+	std::unordered_map<std::string, CacheEntry*> entries;
+	IdleList idle; // least recently used first
+	size_t bytes = 0;
+	size_t budget = ACKNEXT_CACHE_BUDGET;
+};
+
+static CachePool pools[TYPE_LIGHT + 1];
+static std::unordered_map<void const *, CacheEntry*> objects;
+
+static void destroy(ACKTYPE type, void * object)
+{
+	// The entry is already gone, so the remove functions
+	// will delete the object instead of releasing it.
+	switch(type)
+	{
+		case TYPE_BITMAP:   bmap_remove((BITMAP*)object); break;
+		case TYPE_MATERIAL: mtl_remove((MATERIAL*)object); break;
+		case TYPE_MESH:     mesh_remove((MESH*)object); break;
+		case TYPE_SOUND:    snd_remove((SOUND*)object); break;
+		case TYPE_BLOB:     blob_remove((BLOB*)object); break;
+		default: abort();
+	}
+}
+
+static void evict(CacheEntry * entry)
+{
+	CachePool & pool = pools[entry->type];
+	if(entry->references == 0)
+		pool.idle.erase(entry->idle);
+	pool.entries.erase(entry->path);
+	pool.bytes -= entry->bytes;
+	objects.erase(entry->object);
+
+	cache_stats.bytesCached -= entry->bytes;
+
+	destroy(entry->type, entry->object);
+	delete entry;
+}
+
+void ResourceCache::initialize()
+{
+	cache_stats = CACHESTATS { };
+}
+
+void ResourceCache::shutdown()
+{
+	for(CachePool & pool : pools)
+	{
+		while(pool.idle.size() > 0)
+			evict(pool.idle.front());
+
+		// Their holders still release them later, so they stay registered
+		for(auto const & it : pool.entries)
+		{
+			engine_log(
+				"Cached resource '%s' leaked with %d references.",
+				it.second->path.c_str(),
+				it.second->references);
+		}
+	}
+}
+
+bool ResourceCache::supports(ACKTYPE type)
+{
+	switch(type)
+	{
+		case TYPE_BITMAP:
+		case TYPE_MATERIAL:
+		case TYPE_MESH:
+		case TYPE_SOUND:
+		case TYPE_BLOB:
+			return true;
+		default:
+			return false;
+	}
+}
+
+void * ResourceCache::acquire(ACKTYPE type, char const * path)
+{
+	assert(supports(type));
+	CachePool & pool = pools[type];
+	auto it = pool.entries.find(path);
+	if(it == pool.entries.end()) {
+		cache_stats.misses += 1;
+		return nullptr;
+	}
+	CacheEntry * entry = it->second;
+	if(entry->references == 0)
+		pool.idle.erase(entry->idle);
+	entry->references += 1;
+
+	cache_stats.hits += 1;
+	cache_stats.bytesSaved += entry->bytes;
+	return entry->object;
+}
+
+void ResourceCache::insert(ACKTYPE type, char const * path, void * object, size_t bytes)
+{
+	assert(supports(type));
+	assert(object != nullptr);
+	CachePool & pool = pools[type];
+
+	auto it = pool.entries.find(path);
+	if(it != pool.entries.end()) {
+		// Someone loaded it in the meantime, the new object stays uncached
+		return;
+	}
+
+	CacheEntry * entry = new CacheEntry();
+	entry->type = type;
+	entry->path = path;
+	entry->object = object;
+	entry->bytes = bytes;
+	entry->references = 1;
+
+	pool.entries.emplace(entry->path, entry);
+	pool.bytes += bytes;
+	objects.emplace(object, entry);
+
+	cache_stats.bytesLoaded += bytes;
+	cache_stats.bytesCached += bytes;
+}
+
+bool ResourceCache::release(void const * object)
+{
+	auto it = objects.find(object);
+	if(it == objects.end())
+		return false;
+	CacheEntry * entry = it->second;
+	assert(entry->references > 0);
+	entry->references -= 1;
+	if(entry->references == 0)
+	{
+		CachePool & pool = pools[entry->type];
+		entry->idle = pool.idle.insert(pool.idle.end(), entry);
+		trim(entry->type, pool.budget);
+	}
+	return true;
+}
+
+void ResourceCache::setBudget(ACKTYPE type, size_t bytes)
+{
+	assert(supports(type));
+	pools[type].budget = bytes;
+	trim(type, bytes);
+}
+
+void ResourceCache::trim(ACKTYPE type, size_t budget)
+{
+	CachePool & pool = pools[type];
+	while(pool.bytes > budget && pool.idle.size() > 0)
+	{
+		evict(pool.idle.front());
+		cache_stats.evictions += 1;
+	}
+}
+
+ACKNEXT_API_BLOCK
+{
+	CACHESTATS cache_stats;
+
+	void cache_setbudget(ACKTYPE type, size_t bytes)
+	{
+		if(ResourceCache::supports(type) == false) {
+			engine_seterror(ERR_INVALIDARGUMENT, "type %d is not cached!", type);
+			return;
+		}
+		ResourceCache::setBudget(type, bytes);
+	}
+
+	void cache_flush()
+	{
+		for(int type = 0; type <= TYPE_LIGHT; type++)
+		{
+			if(ResourceCache::supports(ACKTYPE(type)))
+				ResourceCache::trim(ACKTYPE(type), 0);
+		}
+	}
+}
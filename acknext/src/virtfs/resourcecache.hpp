@@ -0,0 +1,39 @@
+#ifndef RESOURCECACHE_HPP
+#define RESOURCECACHE_HPP
+
+#include <engine.hpp>
+
+// Shares loaded resources between all users that load the same file.
+// Every acquire/insert holds a reference, release drops it. Resources
+// without references stay cached until their type exceeds its budget,
+// then the least recently used ones are removed.
+class ResourceCache
+{
+public:
+	ResourceCache() = delete;
+
+	static void initialize();
+
+	// Removes all unreferenced resources and logs the leaked ones
+	static void shutdown();
+
+	// Types that can be cached: BITMAP, MATERIAL, MESH, SOUND, BLOB
+	static bool supports(ACKTYPE type);
+
+	// Returns the cached resource with a new reference or nullptr
+	static void * acquire(ACKTYPE type, char const * path);
+
+	// Adds a loaded resource, the caller holds the first reference
+	static void insert(ACKTYPE type, char const * path, void * object, size_t bytes);
+
+	// Drops a reference. Returns false if the object is not cached,
+	// the caller owns it then and has to delete it.
+	static bool release(void const * object);
+
+	static void setBudget(ACKTYPE type, size_t bytes);
+
+	// Removes unreferenced resources until the type fits into its budget
+	static void trim(ACKTYPE type, size_t budget);
+};
+
+#endif // RESOURCECACHE_HPP
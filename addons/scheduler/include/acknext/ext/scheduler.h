@@ -39,8 +39,26 @@ ACKFUN void task_kill(TASK * task); // at all!
 
 ACKFUN void task_yield(); // wait(1)
 
+// Parks the task until the time has passed. Waiting tasks are
+// not resumed before they wake up and cost nothing per frame.
+ACKFUN void task_wait_time(var seconds);
+
+// Parks the task for the given number of scheduler updates,
+// task_wait_frames(1) equals task_yield()
+ACKFUN void task_wait_frames(int frames);
+
+// Parks the task until the event is invoked, returns the event argument
+ACKFUN void * task_wait_event(EVENT * ev);
+
+// Parks the task until the job is done, blocks when called outside of a task
+ACKFUN void task_wait_job(JOB * job);
+
 ACKVAR BITFIELD tasks_enabled;
 
+// Stack size of each task in bytes, read by scheduler_init.
+// 0 uses the default of 1 MiB.
+ACKVAR int task_stack_size;
+
 ACKVAR TASK * SCHEDCONST task_current;
 
 #endif // _ACKNEXT_EXT_SCHEDULER_H_
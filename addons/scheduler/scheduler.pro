@@ -15,4 +15,5 @@ DEFINES += _ACKNEXT_EXT_SCHEDULER_INTERNAL_
 SOURCES += \
     src/scheduler.cpp
 
-HEADERS +=
+HEADERS += \
+    src/timerwheel.hpp
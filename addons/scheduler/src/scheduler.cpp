@@ -4,11 +4,19 @@
 #include "../include/acknext/ext/scheduler.h"
 
 #include <vector>
+#include <map>
+#include <unordered_map>
 #include <algorithm>
+#include <mutex>
 #include <stdlib.h>
 
 #include <coroutine.h>
 
+#include "timerwheel.hpp"
+
+// Resolution of task_wait_time
+#define TIME_TICKS_PER_SECOND 1000
+
 /*
  * Scheduler system:
  * - task_start executes until the first yield() or return, so
@@ -16,14 +24,27 @@
  * - task_defer starts execution after the next yield(),
  *   so initialization can be done on the returned TASK object
  * - Events use task_start to enable synchronous event handling
- * - Tasks are sorted at the start of a frame, new tasks will be appended
- *   to the current queue. When a task is started by task_start, it will
- *   not be executed a second time in the frame it was started
+ * - Tasks live in buckets ordered by priority. New tasks join their
+ *   bucket at the start of the next frame, so a task started by
+ *   task_start will not be executed a second time in the frame it
+ *   was started
+ * - Priority changes are noticed when the task is run and take effect
+ *   in the next frame
+ * - Waiting tasks (task_wait_*) leave their bucket and are put into
+ *   a timer wheel, the waiter list of an event or a job continuation.
+ *   They rejoin their bucket when they wake up, so they cost nothing
+ *   while waiting
+ * - Killed tasks are resumed once more, so their yield throws and the
+ *   task unwinds
+ * - Dead tasks are kept in a pool and reused by the next task_start
+ *   or task_defer, their events are cleared but not recreated
  * - Tasks have a set of task-local variables that reside in a
  *   special section of the engines core. User variables cannot be made
  *   task-local.
  */
 
+struct Bucket;
+
 class Task
 {
 public:
@@ -31,12 +52,28 @@ public:
 	bool shutdown;
 	int id;
 	bool success;
+
+	// Scheduling state
+	Bucket * bucket;
+	size_t slot;
+	bool retired;
+
+	// Waiting state, wake-ups with an old ticket are ignored
+	bool waiting;
+	uint32_t ticket;
+	void * wakeArg;
 public:
-	Task(ENTRYPOINT function, void * context);
+	Task();
 	Task(Task const &) = delete;
 	Task(Task &&) = delete;
 	~Task();
 
+	// (Re-)initializes the task with a fresh coroutine
+	void start(ENTRYPOINT function, void * context);
+
+	// Resets the task so it can be reused by start()
+	void recycle();
+
 	void updateStatus();
 
 	bool alive() const;
@@ -68,68 +105,246 @@ public:
 	int reason() const { return id; }
 };
 
-static std::vector<Task*> tasks;
+// All tasks with the same priority, order inside
+// a bucket is not specified.
+struct Bucket
+{
+	var priority;
+	std::vector<Task*> tasks;
+};
+
+static std::map<var, Bucket> buckets;
+static std::vector<Task*> incoming; // started since the last update
+static std::vector<Task*> moved;    // priority changed
+static std::vector<Task*> retiring; // dead or killed
+static std::vector<Task*> parked;   // started waiting
+static std::vector<Task*> pool;     // recycled, ready for reuse
 static struct schedule * schedule;
 static Task * current = nullptr;
 
+struct Waiter
+{
+	Task * task;
+	uint32_t ticket;
+};
+
+static uint64_t updates = 0;
+static TimerWheel<Waiter> frameWheel;
+static TimerWheel<Waiter> timeWheel;
+static std::unordered_map<EVENT const *, std::vector<Waiter>> eventWaiters;
+
+// Job continuations run on worker threads and only queue their waiter,
+// the next update wakes the tasks. Waiters are pooled.
+static std::mutex jobLock;
+static std::vector<Waiter*> jobsDone; // guarded by jobLock
+static std::vector<Waiter*> jobWaiters;
+static std::vector<Waiter*> jobWaiterPool;
+
+static void bucket_insert(Task * task)
+{
+	Bucket & bucket = buckets[task->api.priority];
+	bucket.priority = task->api.priority;
+	task->bucket = &bucket;
+	task->slot = bucket.tasks.size();
+	bucket.tasks.push_back(task);
+}
+
+// O(1), the last task of the bucket takes the free slot
+static void bucket_remove(Task * task)
+{
+	Bucket * bucket = task->bucket;
+	if(bucket == nullptr)
+		return;
+	Task * last = bucket->tasks.back();
+	bucket->tasks[task->slot] = last;
+	last->slot = task->slot;
+	bucket->tasks.pop_back();
+	task->bucket = nullptr;
+
+	if(bucket->tasks.size() == 0)
+		buckets.erase(bucket->priority);
+}
+
+static Task * task_alloc(ENTRYPOINT function, void * context)
+{
+	Task * task;
+	if(pool.size() > 0) {
+		task = pool.back();
+		pool.pop_back();
+	} else {
+		task = new Task();
+	}
+	task->start(function, context);
+	return task;
+}
+
+static void task_wake(Waiter const & waiter, void * arg)
+{
+	Task * task = waiter.task;
+	if(task->waiting == false || task->ticket != waiter.ticket || task->retired)
+		return;
+	task->waiting = false;
+	task->wakeArg = arg;
+	incoming.push_back(task);
+}
+
+static void task_wake_event(void * context, void * arg)
+{
+	auto it = eventWaiters.find(static_cast<EVENT const *>(context));
+	if(it == eventWaiters.end())
+		return;
+	std::vector<Waiter> waiters;
+	waiters.swap(it->second);
+	eventWaiters.erase(it);
+	for(Waiter const & waiter : waiters)
+		task_wake(waiter, arg);
+}
+
+static void task_wake_job(void * context)
+{
+	std::lock_guard<std::mutex> _(jobLock);
+	jobsDone.push_back(static_cast<Waiter*>(context));
+}
+
+static void task_wake_jobs()
+{
+	{
+		std::lock_guard<std::mutex> _(jobLock);
+		jobWaiters.swap(jobsDone);
+	}
+	for(Waiter * waiter : jobWaiters)
+	{
+		task_wake(*waiter, nullptr);
+		jobWaiterPool.push_back(waiter);
+	}
+	jobWaiters.clear();
+}
+
+static uint64_t time_ticks(var seconds)
+{
+	if(seconds <= 0)
+		return 0;
+	return uint64_t(double(seconds) * TIME_TICKS_PER_SECOND);
+}
+
+// New waiter for the current task, invalidates all older ones
+static Waiter task_prepare_wait()
+{
+	Task * task = ::current;
+	task->ticket += 1;
+	return Waiter { task, task->ticket };
+}
+
+static void task_park()
+{
+	Task * task = ::current;
+	task->waiting = true;
+	parked.push_back(task);
+	task_yield();
+}
+
+static void task_retire(Task * task)
+{
+	if(task->retired)
+		return;
+	task->retired = true;
+	retiring.push_back(task);
+}
+
 extern "C" void scheduler_init()
 {
-	schedule = coroutine_open();
+	schedule = coroutine_open_ex(size_t(std::max(0, task_stack_size)));
+	updates = 0;
+	frameWheel.reset(0);
+	timeWheel.reset(time_ticks(total_time));
 }
 
 extern "C" void scheduler_update()
 {
-	for(size_t i = 0; i < tasks.size();)
+	updates += 1;
+	frameWheel.advance(updates, [](Waiter const & waiter) { task_wake(waiter, nullptr); });
+	timeWheel.advance(time_ticks(total_time), [](Waiter const & waiter) { task_wake(waiter, nullptr); });
+	task_wake_jobs();
+
+	for(Task * task : parked)
 	{
-		Task * co = tasks.at(i);
-		if((co->alive() == false) || co->shutdown) {
-			delete co;
-			tasks.erase(tasks.begin() + i);
-		} else {
-			i += 1;
-		}
+		if(task->waiting)
+			bucket_remove(task);
 	}
+	parked.clear();
 
-	// Sort for priority.
-	std::sort(
-		tasks.begin(),
-        tasks.end(),
-		[](Task * a, Task * b) {
-			return a->api.priority < b->api.priority;
-		});
-
-	// Schedule everything
-	for(Task * co : tasks)
+	for(Task * task : moved)
 	{
-		if(co->shutdown) {
-			continue;
-		}
-		// Skip all masked tasks
-		if(!co->enabled()) {
-			co->updateStatus();
+		if(task->retired || task->bucket == nullptr)
 			continue;
+		bucket_remove(task);
+		bucket_insert(task);
+	}
+	moved.clear();
+
+	for(Task * task : incoming)
+	{
+		if(task->retired == false && task->waiting == false && task->bucket == nullptr)
+			bucket_insert(task);
+	}
+	incoming.clear();
+
+	// Indexed, unwinding tasks may kill others
+	for(size_t i = 0; i < retiring.size(); i++)
+	{
+		Task * task = retiring[i];
+		if(task->status() == COROUTINE_SUSPEND) {
+			// Killed while suspended, let the task unwind
+			task->waiting = false;
+			task->ticket += 1;
+			task->resume();
 		}
-		switch(co->status())
+		bucket_remove(task);
+		task->recycle();
+		pool.push_back(task);
+	}
+	retiring.clear();
+
+	// Schedule everything. Buckets are not modified while running,
+	// tasks started now are queued in incoming.
+	for(auto & entry : buckets)
+	{
+		Bucket & bucket = entry.second;
+		for(Task * co : bucket.tasks)
 		{
-			case COROUTINE_RUNNING:
-				engine_log("Somehow scheduler_update got called "
-						   "from within a coroutine!");
+			if(co->shutdown || co->retired || co->waiting) {
 				continue;
-			case COROUTINE_DEAD:
-				// this should never happen!
+			}
+			// Skip all masked tasks
+			if(!co->enabled()) {
+				co->api.state = TASK_DISABLED;
 				continue;
-			case COROUTINE_READY:
-			case COROUTINE_SUSPEND:
+			}
+			if(co->api.priority != bucket.priority) {
+				moved.push_back(co);
+			}
+			switch(co->status())
 			{
-				co->resume();
-				break;
+				case COROUTINE_RUNNING:
+					engine_log("Somehow scheduler_update got called "
+							   "from within a coroutine!");
+					continue;
+				case COROUTINE_DEAD:
+					// this should never happen!
+					continue;
+				case COROUTINE_READY:
+				case COROUTINE_SUSPEND:
+				{
+					co->resume();
+					break;
+				}
+				default:
+					engine_log(
+						"Coroutine %d is in unknown status %d!",
+						co->id,
+						co->status());
+					break;
 			}
-			default:
-				engine_log(
-					"Coroutine %d is in unknown status %d!",
-					co->id,
-					co->status());
-				break;
 		}
 	}
 }
@@ -137,12 +352,29 @@ extern "C" void scheduler_update()
 extern "C" void scheduler_shutdown()
 {
 	coroutine_close(schedule);
+
+	frameWheel.clear();
+	timeWheel.clear();
+	eventWaiters.clear();
+	parked.clear();
+
+	// Waiters of unfinished jobs are still referenced by their continuation
+	task_wake_jobs();
+	for(Waiter * waiter : jobWaiterPool)
+		delete waiter;
+	jobWaiterPool.clear();
+
+	for(Task * task : pool)
+		delete task;
+	pool.clear();
 }
 
 extern "C"
 {
 	BITFIELD tasks_enabled = BITFIELD_ALL;
 
+	int task_stack_size = 0;
+
 	TASK * task_current;
 
 	TASK * task_start(ENTRYPOINT function, void * context)
@@ -152,8 +384,8 @@ extern "C"
 			return nullptr;
 		}
 
-		Task * task = new Task(function, context);
-	    tasks.emplace_back(task);
+		Task * task = task_alloc(function, context);
+		incoming.push_back(task);
 		task->resume();
 
 		return (TASK*)task;
@@ -166,8 +398,8 @@ extern "C"
 			return nullptr;
 		}
 
-		Task * task = new Task(function, context);
-	    tasks.emplace_back(task);
+		Task * task = task_alloc(function, context);
+		incoming.push_back(task);
 		return (TASK*)task;
 	}
 
@@ -192,6 +424,7 @@ extern "C"
 			throw CoError(CoError::kill);
 		} else {
 			task->shutdown = true;
+			task_retire(task);
 		}
 	}
 
@@ -217,23 +450,130 @@ extern "C"
 	    }
 	}
 
+	void task_wait_time(var seconds)
+	{
+		if(::current == nullptr) {
+			engine_log("Call to task_wait_time() outside a coroutine!");
+			return;
+		}
+		timeWheel.add(time_ticks(total_time + seconds), task_prepare_wait());
+		task_park();
+	}
+
+	void task_wait_frames(int frames)
+	{
+		if(::current == nullptr) {
+			engine_log("Call to task_wait_frames() outside a coroutine!");
+			return;
+		}
+		if(frames <= 1) {
+			task_yield();
+			return;
+		}
+		frameWheel.add(updates + uint64_t(frames), task_prepare_wait());
+		task_park();
+	}
+
+	void * task_wait_event(EVENT * ev)
+	{
+		if(ev == nullptr) {
+			engine_seterror(ERR_INVALIDARGUMENT, "ev must not be NULL!");
+			return nullptr;
+		}
+		if(::current == nullptr) {
+			engine_log("Call to task_wait_event() outside a coroutine!");
+			return nullptr;
+		}
+		eventWaiters[ev].push_back(task_prepare_wait());
+		// Attaching is idempotent, the handler stays attached after waking
+		event_attachExt(ev, &task_wake_event, ev);
+		task_park();
+		return ::current->wakeArg;
+	}
+
+	void task_wait_job(JOB * job)
+	{
+		if(job == nullptr) {
+			engine_seterror(ERR_INVALIDARGUMENT, "job must not be NULL!");
+			return;
+		}
+		if(::current == nullptr) {
+			job_wait(job);
+			return;
+		}
+		if(job_done(job))
+			return;
+
+		Waiter * waiter;
+		if(jobWaiterPool.size() > 0) {
+			waiter = jobWaiterPool.back();
+			jobWaiterPool.pop_back();
+		} else {
+			waiter = new Waiter();
+		}
+		*waiter = task_prepare_wait();
+
+		// Runs right away when the job finished in the meantime
+		job_remove(job_submit(&task_wake_job, waiter, &job, 1));
+		task_park();
+	}
+
 }
 
-Task::Task(ENTRYPOINT function, void *context) :
+Task::Task() :
     shutdown(false),
-    id(coroutine_new(::schedule, &Task::Trampoline, this)),
-    success(false)
+    id(-1),
+    success(false),
+    bucket(nullptr),
+    slot(0),
+    retired(false),
+    waiting(false),
+    ticket(0),
+    wakeArg(nullptr)
+{
+	api.function = nullptr;
+	api.context = nullptr;
+	api.priority = 0;
+	api.state = TASK_DEAD;
+	api.mask = BITFIELD_ALL;
+	api.failed = event_create();
+	api.finished = event_create();
+}
+
+void Task::start(ENTRYPOINT function, void * context)
 {
+	this->shutdown = false;
+	this->success = false;
+	this->bucket = nullptr;
+	this->slot = 0;
+	this->retired = false;
+	this->waiting = false;
+	this->wakeArg = nullptr;
+	this->id = coroutine_new(::schedule, &Task::Trampoline, this);
+
 	api.function = function;
 	api.context = context;
+	api.priority = 0;
 	api.state = TASK_READY;
 	api.mask = BITFIELD_ALL;
-	api.failed = event_create();
-	api.finished = event_create();
 
 	this->updateStatus();
 }
 
+void Task::recycle()
+{
+	// Killed before it ever ran, the coroutine still holds its slot and stack
+	if(this->status() == COROUTINE_READY)
+		coroutine_abort(::schedule, this->id);
+	this->id = -1;
+
+	event_clear(api.failed);
+	event_clear(api.finished);
+	api.state = TASK_DEAD;
+	this->waiting = false;
+	this->ticket += 1;
+}
+
 Task::~Task()
 {
 	event_remove(api.failed);
@@ -247,6 +587,8 @@ bool Task::alive() const
 
 int Task::status() const
 {
+	if(this->id < 0)
+		return COROUTINE_DEAD;
 	return coroutine_status(::schedule, this->id);
 }
 
@@ -266,6 +608,9 @@ void Task::resume()
 
 	if(this->alive() == false)
 	{
+		// The slot is free now and may be handed to the next new task
+		this->id = -1;
+		task_retire(this);
 		if(this->success)
 		{
 			event_invoke(this->api.finished, this->api.context);
@@ -283,6 +628,10 @@ void Task::updateStatus()
 		api.state = TASK_DISABLED;
 		return;
 	}
+	if(this->waiting) {
+		api.state = TASK_WAITING;
+		return;
+	}
 	switch(this->status())
 	{
 		case COROUTINE_DEAD:
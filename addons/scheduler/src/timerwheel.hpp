@@ -0,0 +1,108 @@
+#ifndef TIMERWHEEL_HPP
+#define TIMERWHEEL_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Hierarchical timer wheel. Timers are sorted into 4 levels of
+// 256 slots each, level n covers 256^(n+1) ticks. Advancing the
+// wheel only touches the slots of the passed ticks, timers of the
+// higher levels are moved down when their slot is reached.
+template<typename T>
+class TimerWheel
+{
+private:
+	static const int levels = 4;
+	static const int bits = 8;
+	static const uint64_t slots = 1 << bits;
+	static const uint64_t mask = slots - 1;
+
+	struct Timer
+	{
+		uint64_t deadline;
+		T value;
+	};
+private:
+	std::vector<Timer> wheel[levels][slots];
+	std::vector<Timer> overflow; // beyond the last level
+	uint64_t current;
+public:
+	TimerWheel() : current(0) { }
+	TimerWheel(TimerWheel const &) = delete;
+
+	uint64_t now() const { return this->current; }
+
+	// Timers in the past fire on the next advance()
+	void add(uint64_t deadline, T const & value)
+	{
+		if(deadline <= this->current)
+			deadline = this->current + 1;
+		this->insert(Timer { deadline, value });
+	}
+
+	// Fires all timers up to and including tick `to`
+	template<typename F>
+	void advance(uint64_t to, F const & fire)
+	{
+		while(this->current < to)
+		{
+			this->current += 1;
+			this->cascade(1);
+
+			std::vector<Timer> & slot = this->wheel[0][this->current & mask];
+			for(size_t i = 0; i < slot.size(); i++)
+				fire(slot[i].value);
+			slot.clear();
+		}
+	}
+
+	// Removes all timers and restarts at tick `now`
+	void reset(uint64_t now)
+	{
+		this->clear();
+		this->current = now;
+	}
+
+	void clear()
+	{
+		for(auto & level : this->wheel) {
+			for(auto & slot : level)
+				slot.clear();
+		}
+		this->overflow.clear();
+	}
+private:
+	void insert(Timer const & timer)
+	{
+		uint64_t delta = timer.deadline - this->current;
+		for(int level = 0; level < levels; level++)
+		{
+			if(delta < (uint64_t(1) << (bits * (level + 1)))) {
+				uint64_t index = (timer.deadline >> (bits * level)) & mask;
+				this->wheel[level][index].push_back(timer);
+				return;
+			}
+		}
+		this->overflow.push_back(timer);
+	}
+
+	// Moves the timers of level into the lower levels when
+	// the lower level wrapped around
+	void cascade(int level)
+	{
+		if(((this->current >> (bits * (level - 1))) & mask) != 0)
+			return;
+		std::vector<Timer> pending;
+		if(level < levels) {
+			this->cascade(level + 1);
+			pending.swap(this->wheel[level][(this->current >> (bits * level)) & mask]);
+		} else {
+			pending.swap(this->overflow);
+		}
+		for(Timer const & timer : pending)
+			this->insert(timer);
+	}
+};
+
+#endif // TIMERWHEEL_HPP
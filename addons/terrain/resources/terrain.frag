@@ -1,5 +1,4 @@
 #version 330
-#define LIGHT_LIMIT 16
 
 in vec3 position;
 in vec2 uv0;
@@ -14,9 +13,22 @@ uniform vec4 vecEmission;
 uniform vec4 vecColor;
 uniform vec3 vecAttributes;
 
-uniform vec3 vecViewPos;
 uniform vec3 vecViewDir;
 
+layout(std140) uniform FrameBlock
+{
+	mat4 matView;
+	mat4 matProj;
+	mat4 matViewProj;
+	vec3 vecViewPos;
+	float fArc; // tan(0.5 * fov)
+	vec4 vecFogColor; // rgb + density
+	vec4 vecClusterViewport; // xy: viewport origin, zw: tiles per pixel
+	ivec4 vecClusterSize; // tiles x, tiles y, depth slices, global lights
+	vec2 vecClusterDepth; // depth slice = log(depth) * x + y
+	int iLightCount;
+};
+
 layout(location = 0) out vec3 frag_Color;
 layout(location = 1) out vec3 frag_Position;
 layout(location = 2) out vec3 frag_Normal;
@@ -29,8 +41,6 @@ vec3 applyLighting(
 
 vec3 applyFog(vec3 position, vec3 surface);
 
-uniform int iLightCount;
-
 in float distance;
 
 float sum( vec3 v ) { return v.x+v.y+v.z; }
@@ -1,6 +1,8 @@
 #ifndef C_COROUTINE_H
 #define C_COROUTINE_H
 
+#include <stddef.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -15,6 +17,8 @@ struct schedule;
 typedef void (*coroutine_func)(struct schedule *, void *ud);
 
 struct schedule * coroutine_open(void);
+// stack_size is the stack size of each coroutine, 0 uses the default (1 MiB)
+struct schedule * coroutine_open_ex(size_t stack_size);
 void coroutine_close(struct schedule *);
 
 int coroutine_new(struct schedule *, coroutine_func, void *ud);
@@ -22,6 +26,10 @@ void coroutine_resume(struct schedule *, int id);
 int coroutine_status(struct schedule *, int id);
 int coroutine_running(struct schedule *);
 void coroutine_yield(struct schedule *);
+// Drops a coroutine that was never resumed and keeps its stack for reuse.
+// Returns 0 for coroutines that are running or suspended, those have to
+// be resumed until they return instead.
+int coroutine_abort(struct schedule *, int id);
 
 
 #ifdef __cplusplus
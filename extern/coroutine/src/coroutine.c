@@ -5,12 +5,25 @@
 #include <stddef.h>
 #include <string.h>
 #include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
 
-#if __APPLE__ && __MACH__
-	#include <sys/ucontext.h>
-#else 
-	#include <ucontext.h>
-#endif 
+// Every coroutine runs on its own stack with a guard page below it.
+// On x86-64 the context switch only swaps the callee-saved registers,
+// everything else (or COROUTINE_UCONTEXT defined) uses swapcontext.
+#if defined(__x86_64__) && !defined(COROUTINE_UCONTEXT)
+	#define COROUTINE_ASM 1
+#else
+	#if __APPLE__ && __MACH__
+		#include <sys/ucontext.h>
+	#else
+		#include <ucontext.h>
+	#endif
+#endif
+
+#ifndef MAP_STACK
+	#define MAP_STACK 0
+#endif
 
 #define STACK_SIZE (1024*1024)
 #define DEFAULT_COROUTINE 16
@@ -18,47 +31,137 @@
 struct coroutine;
 
 struct schedule {
-	char stack[STACK_SIZE];
+	size_t stack_size;
+	size_t page_size;
+#if COROUTINE_ASM
+	void *main;
+#else
 	ucontext_t main;
+#endif
 	int nco;
 	int cap;
 	int running;
 	struct coroutine **co;
+	struct coroutine *pool; // dead coroutines, keep their stacks
 };
 
 struct coroutine {
 	coroutine_func func;
 	void *ud;
+#if COROUTINE_ASM
+	void *sp;
+#else
 	ucontext_t ctx;
+#endif
 	struct schedule * sch;
-	ptrdiff_t cap;
-	ptrdiff_t size;
 	int status;
-	char *stack;
+	char *stack; // mapping including the guard page
+	struct coroutine *next_free;
 };
 
-struct coroutine * 
+#if COROUTINE_ASM
+
+// void _co_switch(void **save_sp, void *load_sp)
+// Pushes the callee-saved registers, MXCSR and the x87 control word,
+// stores the stack pointer, loads the other one and pops the same.
+__asm__ (
+	".text\n"
+	".p2align 4\n"
+	".type _co_switch,@function\n"
+	"_co_switch:\n"
+	"	pushq %rbp\n"
+	"	pushq %rbx\n"
+	"	pushq %r12\n"
+	"	pushq %r13\n"
+	"	pushq %r14\n"
+	"	pushq %r15\n"
+	"	subq $8, %rsp\n"
+	"	stmxcsr (%rsp)\n"
+	"	fnstcw 4(%rsp)\n"
+	"	movq %rsp, (%rdi)\n"
+	"	movq %rsi, %rsp\n"
+	"	ldmxcsr (%rsp)\n"
+	"	fldcw 4(%rsp)\n"
+	"	addq $8, %rsp\n"
+	"	popq %r15\n"
+	"	popq %r14\n"
+	"	popq %r13\n"
+	"	popq %r12\n"
+	"	popq %rbx\n"
+	"	popq %rbp\n"
+	"	ret\n"
+	".size _co_switch,.-_co_switch\n"
+	"\n"
+	// First return target of a new coroutine, the schedule is in r12
+	".p2align 4\n"
+	".type _co_entry,@function\n"
+	"_co_entry:\n"
+	"	movq %r12, %rdi\n"
+	"	call _co_main\n"
+	"	ud2\n"
+	".size _co_entry,.-_co_entry\n"
+);
+
+void _co_switch(void **save_sp, void *load_sp);
+void _co_entry(void);
+void _co_main(struct schedule *S) __attribute__((noreturn, used, visibility("hidden")));
+
+#endif
+
+static char *
+_co_stack_alloc(struct schedule *S) {
+	size_t length = S->stack_size + S->page_size;
+	void * mem = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+	if (mem == MAP_FAILED)
+		return NULL;
+	// guard page, stacks grow down
+	mprotect(mem, S->page_size, PROT_NONE);
+	return mem;
+}
+
+struct coroutine *
 _co_new(struct schedule *S , coroutine_func func, void *ud) {
-	struct coroutine * co = malloc(sizeof(*co));
+	struct coroutine * co = S->pool;
+	if (co) {
+		S->pool = co->next_free;
+	} else {
+		co = malloc(sizeof(*co));
+		co->stack = _co_stack_alloc(S);
+		assert(co->stack != NULL);
+	}
 	co->func = func;
 	co->ud = ud;
 	co->sch = S;
-	co->cap = 0;
-	co->size = 0;
 	co->status = COROUTINE_READY;
-	co->stack = NULL;
+	co->next_free = NULL;
 	return co;
 }
 
 void
 _co_delete(struct coroutine *co) {
-	free(co->stack);
+	munmap(co->stack, co->sch->stack_size + co->sch->page_size);
 	free(co);
 }
 
-struct schedule * 
+static void
+_co_recycle(struct schedule *S, struct coroutine *co) {
+	co->next_free = S->pool;
+	S->pool = co;
+}
+
+struct schedule *
 coroutine_open(void) {
+	return coroutine_open_ex(0);
+}
+
+struct schedule *
+coroutine_open_ex(size_t stack_size) {
 	struct schedule *S = malloc(sizeof(*S));
+	S->page_size = (size_t)sysconf(_SC_PAGESIZE);
+	if (stack_size == 0)
+		stack_size = STACK_SIZE;
+	S->stack_size = (stack_size + S->page_size - 1) & ~(S->page_size - 1);
+	S->pool = NULL;
 	S->nco = 0;
 	S->cap = DEFAULT_COROUTINE;
 	S->running = -1;
@@ -67,7 +170,7 @@ coroutine_open(void) {
 	return S;
 }
 
-void 
+void
 coroutine_close(struct schedule *S) {
 	int i;
 	for (i=0;i<S->cap;i++) {
@@ -76,12 +179,17 @@ coroutine_close(struct schedule *S) {
 			_co_delete(co);
 		}
 	}
+	while (S->pool) {
+		struct coroutine * co = S->pool;
+		S->pool = co->next_free;
+		_co_delete(co);
+	}
 	free(S->co);
 	S->co = NULL;
 	free(S);
 }
 
-int 
+int
 coroutine_new(struct schedule *S, coroutine_func func, void *ud) {
 	struct coroutine *co = _co_new(S, func , ud);
 	if (S->nco >= S->cap) {
@@ -107,20 +215,56 @@ coroutine_new(struct schedule *S, coroutine_func func, void *ud) {
 	return -1;
 }
 
+// Runs the coroutine function, the coroutine is dead afterwards
 static void
-mainfunc(uint32_t low32, uint32_t hi32) {
-	uintptr_t ptr = (uintptr_t)low32 | ((uintptr_t)hi32 << 32);
-	struct schedule *S = (struct schedule *)ptr;
+_co_run(struct schedule *S) {
 	int id = S->running;
 	struct coroutine *C = S->co[id];
 	C->func(S,C->ud);
-	_co_delete(C);
+	_co_recycle(S, C);
 	S->co[id] = NULL;
 	--S->nco;
 	S->running = -1;
 }
 
-void 
+#if COROUTINE_ASM
+
+void
+_co_main(struct schedule *S) {
+	_co_run(S);
+	// The stack is not used anymore, the saved pointer is discarded
+	void *dead;
+	_co_switch(&dead, S->main);
+	abort();
+}
+
+static void
+_co_prepare(struct schedule *S, struct coroutine *C) {
+	// Initial frame as popped by _co_switch, the stack pointer
+	// is 16 byte aligned when _co_entry calls _co_main.
+	uint64_t *sp = (uint64_t *)(C->stack + S->page_size + S->stack_size) - 10;
+	sp[0] = 0x037F00001F80ULL; // default MXCSR and x87 control word
+	sp[1] = 0; // r15
+	sp[2] = 0; // r14
+	sp[3] = 0; // r13
+	sp[4] = (uint64_t)(uintptr_t)S; // r12
+	sp[5] = 0; // rbx
+	sp[6] = 0; // rbp
+	sp[7] = (uint64_t)(uintptr_t)&_co_entry;
+	C->sp = sp;
+}
+
+#else
+
+static void
+mainfunc(uint32_t low32, uint32_t hi32) {
+	uintptr_t ptr = (uintptr_t)low32 | ((uintptr_t)hi32 << 32);
+	_co_run((struct schedule *)ptr);
+}
+
+#endif
+
+void
 coroutine_resume(struct schedule * S, int id) {
 	assert(S->running == -1);
 	assert(id >=0 && id < S->cap);
@@ -130,53 +274,61 @@ coroutine_resume(struct schedule * S, int id) {
 	int status = C->status;
 	switch(status) {
 	case COROUTINE_READY:
+#if COROUTINE_ASM
+		_co_prepare(S, C);
+#else
 		getcontext(&C->ctx);
-		C->ctx.uc_stack.ss_sp = S->stack;
-		C->ctx.uc_stack.ss_size = STACK_SIZE;
+		C->ctx.uc_stack.ss_sp = C->stack + S->page_size;
+		C->ctx.uc_stack.ss_size = S->stack_size;
 		C->ctx.uc_link = &S->main;
-		S->running = id;
-		C->status = COROUTINE_RUNNING;
 		uintptr_t ptr = (uintptr_t)S;
 		makecontext(&C->ctx, (void (*)(void)) mainfunc, 2, (uint32_t)ptr, (uint32_t)(ptr>>32));
-		swapcontext(&S->main, &C->ctx);
-		break;
+#endif
+		// fall through
 	case COROUTINE_SUSPEND:
-		memcpy(S->stack + STACK_SIZE - C->size, C->stack, C->size);
 		S->running = id;
 		C->status = COROUTINE_RUNNING;
+#if COROUTINE_ASM
+		_co_switch(&S->main, C->sp);
+#else
 		swapcontext(&S->main, &C->ctx);
+#endif
 		break;
 	default:
 		assert(0);
 	}
 }
 
-static void
-_save_stack(struct coroutine *C, char *top) {
-	char dummy = 0;
-	assert(top - &dummy <= STACK_SIZE);
-	if (C->cap < top - &dummy) {
-		free(C->stack);
-		C->cap = top-&dummy;
-		C->stack = malloc(C->cap);
-	}
-	C->size = top - &dummy;
-	memcpy(C->stack, &dummy, C->size);
-}
-
 void
 coroutine_yield(struct schedule * S) {
 	int id = S->running;
 	assert(id >= 0);
 	struct coroutine * C = S->co[id];
-	assert((char *)&C > S->stack);
-	_save_stack(C,S->stack + STACK_SIZE);
+	assert((char *)&C > C->stack + S->page_size);
 	C->status = COROUTINE_SUSPEND;
 	S->running = -1;
+#if COROUTINE_ASM
+	_co_switch(&C->sp, S->main);
+#else
 	swapcontext(&C->ctx , &S->main);
+#endif
+}
+
+int
+coroutine_abort(struct schedule * S, int id) {
+	assert(id>=0 && id < S->cap);
+	struct coroutine * C = S->co[id];
+	if (C == NULL)
+		return 1;
+	if (C->status != COROUTINE_READY)
+		return 0;
+	_co_recycle(S, C);
+	S->co[id] = NULL;
+	--S->nco;
+	return 1;
 }
 
-int 
+int
 coroutine_status(struct schedule * S, int id) {
 	assert(id>=0 && id < S->cap);
 	if (S->co[id] == NULL) {
@@ -185,8 +337,7 @@ coroutine_status(struct schedule * S, int id) {
 	return S->co[id]->status;
 }
 
-int 
+int
 coroutine_running(struct schedule * S) {
 	return S->running;
 }
-
@@ -1,5 +1,4 @@
 #version 330
-#define LIGHT_LIMIT 16
 
 float attenuate(vec3 P, vec3 lightCentre, float lightRadius, float cutoff);
 float beckmannDistribution(float x, float roughness);
@@ -20,91 +19,153 @@ float cookTorranceSpecular(
 
 struct LightSource
 {
-	/*0*/ int type;
-	/*1*/ float intensity;
-	/*2*/ float arc; // actually cos(arc) for convenience
-	/*4*/ vec3 position;
-	/*8*/ vec3 direction;
-	/*C*/ vec3 color;
+	int type;
+	float intensity;
+	float arc; // actually cos(arc) for convenience
+	vec3 position;
+	vec3 direction;
+	vec3 color;
 };
 
-// std140 is necessary for alignment!
-layout(std140) uniform LightBlock
+// Three texels per light, global lights first
+uniform samplerBuffer texLightData;
+
+// (offset, count) into texLightIndices per cluster
+uniform usamplerBuffer texLightClusters;
+uniform usamplerBuffer texLightIndices;
+
+layout(std140) uniform FrameBlock
 {
-	LightSource lights[LIGHT_LIMIT];
+	mat4 matView;
+	mat4 matProj;
+	mat4 matViewProj;
+	vec3 vecViewPos;
+	float fArc; // tan(0.5 * fov)
+	vec4 vecFogColor; // rgb + density
+	vec4 vecClusterViewport; // xy: viewport origin, zw: tiles per pixel
+	ivec4 vecClusterSize; // tiles x, tiles y, depth slices, global lights
+	vec2 vecClusterDepth; // depth slice = log(depth) * x + y
+	int iLightCount;
 };
 
-uniform int iLightCount;
-uniform vec3 vecViewPos;
+LightSource fetchLight(int index)
+{
+	vec4 t0 = texelFetch(texLightData, 3 * index + 0);
+	vec4 t1 = texelFetch(texLightData, 3 * index + 1);
+	vec4 t2 = texelFetch(texLightData, 3 * index + 2);
+	return LightSource(int(t0.w), t1.w, t2.w, t0.xyz, t1.xyz, t2.xyz);
+}
+
+uvec2 fetchCluster(vec3 position)
+{
+	vec2 tile = (gl_FragCoord.xy - vecClusterViewport.xy) * vecClusterViewport.zw;
+	float depth = max(-(matView * vec4(position, 1)).z, 0.0001);
+	float slice = log(depth) * vecClusterDepth.x + vecClusterDepth.y;
+	ivec3 cluster = clamp(
+		ivec3(ivec2(tile), int(slice)),
+		ivec3(0),
+		vecClusterSize.xyz - 1);
+	int index = (cluster.z * vecClusterSize.y + cluster.y) * vecClusterSize.x + cluster.x;
+	return texelFetch(texLightClusters, index).xy;
+}
 
-vec3 applyLighting(
+int clusterLightCount(vec3 position)
+{
+	return vecClusterSize.w + int(fetchCluster(position).y);
+}
+
+vec3 shadeLight(
+	LightSource light,
 	vec3 position,
+	vec3 toView,
 	vec3 normal,
 	float roughness, float metallic, float fresnell,
 	vec3 cAlbedo)
 {
 	float albedo = 0.96;
-	vec3 toView = normalize(vecViewPos - position);
+	vec3 toLight = light.direction;
+	float atten = 1.0;
 
-	vec3 sDiffuse = vec3(0);
-	vec3 sSpecular = vec3(0);
-
-	int limit = min(LIGHT_LIMIT, iLightCount);
-	for(int i = 0; i < limit; i++)
+	switch(light.type)
 	{
-		vec3 toLight = lights[i].direction;
-		float atten = 1.0;
-
-		switch(lights[i].type)
-		{
-		case 0: // ambient
-			sDiffuse += lights[i].color * mix(cAlbedo.rgb, vec3(0), metallic);
-			continue;
-		case 1: // point
-			atten = attenuate(
-			            position,
-			            lights[i].position,
-			            lights[i].intensity,
-			            1.0 / 512.0);
-			toLight = normalize(lights[i].position - position);
-			break;
-		case 2: // directional
-			atten = 1.0;
-			toLight = -lights[i].direction;
-			break;
-		case 3: // spot
-			toLight = normalize(lights[i].position - position);
-			atten = attenuate(
-			            position,
-			            lights[i].position,
-			            lights[i].intensity,
-			            1.0 / 512.0);
-			if(dot(lights[i].direction, -toLight) < lights[i].arc) {
-				atten = 0;
-			}
-			break;
-		default: discard;
+	case 0: // ambient
+		return light.color * mix(cAlbedo.rgb, vec3(0), metallic);
+	case 1: // point
+		atten = attenuate(
+		            position,
+		            light.position,
+		            light.intensity,
+		            1.0 / 512.0);
+		toLight = normalize(light.position - position);
+		break;
+	case 2: // directional
+		atten = 1.0;
+		toLight = -light.direction;
+		break;
+	case 3: // spot
+		toLight = normalize(light.position - position);
+		atten = attenuate(
+		            position,
+		            light.position,
+		            light.intensity,
+		            1.0 / 512.0);
+		if(dot(light.direction, -toLight) < light.arc) {
+			atten = 0;
 		}
+		break;
+	default: discard;
+	}
 
-		float ond = orenNayarDiffuse(
-		            toLight,
-		            toView,
-		            normal,
-		            roughness,
-		            albedo);
+	float ond = orenNayarDiffuse(
+	            toLight,
+	            toView,
+	            normal,
+	            roughness,
+	            albedo);
 
-		float cts = cookTorranceSpecular(
-		            toLight,
-		            toView,
-		            normal,
-		            roughness,
-		            fresnell);
+	float cts = cookTorranceSpecular(
+	            toLight,
+	            toView,
+	            normal,
+	            roughness,
+	            fresnell);
 
-		cts *= dot(normal, toLight);
+	cts *= dot(normal, toLight);
 
-		sDiffuse += atten * lights[i].color * ond * mix(cAlbedo.rgb, vec3(0), metallic);
-		sSpecular += atten * lights[i].color * cts * mix(vec3(1), cAlbedo.rgb, metallic);
+	return atten * light.color * ond * mix(cAlbedo.rgb, vec3(0), metallic)
+	     + atten * light.color * cts * mix(vec3(1), cAlbedo.rgb, metallic);
+}
+
+vec3 applyLighting(
+	vec3 position,
+	vec3 normal,
+	float roughness, float metallic, float fresnell,
+	vec3 cAlbedo)
+{
+	vec3 toView = normalize(vecViewPos - position);
+
+	vec3 result = vec3(0);
+
+	// ambient and sun lights are not clustered
+	for(int i = 0; i < vecClusterSize.w; i++)
+	{
+		result += shadeLight(
+			fetchLight(i),
+			position, toView, normal,
+			roughness, metallic, fresnell,
+			cAlbedo);
+	}
+
+	uvec2 cluster = fetchCluster(position);
+	for(uint i = 0u; i < cluster.y; i++)
+	{
+		int index = int(texelFetch(texLightIndices, int(cluster.x + i)).r);
+		result += shadeLight(
+			fetchLight(index),
+			position, toView, normal,
+			roughness, metallic, fresnell,
+			cAlbedo);
 	}
 
-	return sDiffuse + sSpecular;
+	return result;
 }
@@ -39,8 +39,19 @@ float fogFactorLinear(const float dist, const float start, const float end)
   return 1.0 - clamp((end - dist) / (end - start), 0.0, 1.0);
 }
 
-uniform vec4 vecFogColor; // rgb + density
-uniform vec3 vecViewPos;
+layout(std140) uniform FrameBlock
+{
+	mat4 matView;
+	mat4 matProj;
+	mat4 matViewProj;
+	vec3 vecViewPos;
+	float fArc; // tan(0.5 * fov)
+	vec4 vecFogColor; // rgb + density
+	vec4 vecClusterViewport; // xy: viewport origin, zw: tiles per pixel
+	ivec4 vecClusterSize; // tiles x, tiles y, depth slices, global lights
+	vec2 vecClusterDepth; // depth slice = log(depth) * x + y
+	int iLightCount;
+};
 
 vec3 applyFog(vec3 position, vec3 surface)
 {
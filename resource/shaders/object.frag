@@ -1,5 +1,4 @@
 #version 330
-#define LIGHT_LIMIT 16
 
 in vec3 position;
 in vec3 tangent;
@@ -24,9 +23,22 @@ uniform vec4 vecEmission;
 uniform vec4 vecAlbedo;
 uniform vec3 vecAttributes;
 
-uniform vec3 vecViewPos;
 uniform vec3 vecViewDir;
 
+layout(std140) uniform FrameBlock
+{
+	mat4 matView;
+	mat4 matProj;
+	mat4 matViewProj;
+	vec3 vecViewPos;
+	float fArc; // tan(0.5 * fov)
+	vec4 vecFogColor; // rgb + density
+	vec4 vecClusterViewport; // xy: viewport origin, zw: tiles per pixel
+	ivec4 vecClusterSize; // tiles x, tiles y, depth slices, global lights
+	vec2 vecClusterDepth; // depth slice = log(depth) * x + y
+	int iLightCount;
+};
+
 uniform bool useNormalMapping = false;
 
 vec3 applyLighting(
@@ -37,7 +49,7 @@ vec3 applyLighting(
 
 vec3 applyFog(vec3 position, vec3 surface);
 
-uniform int iLightCount;
+int clusterLightCount(vec3 position);
 
 void main() {
 
@@ -88,7 +100,7 @@ void main() {
 		frag_Color = 0.5 + 0.5 * realNormal;
 		return;
 	} else if(iDebugMode == 3) {
-		frag_Color = vec3(float(iLightCount) / (LIGHT_LIMIT - 1));
+		frag_Color = vec3(float(clusterLightCount(position)) / 16.0);
 		return;
 	}
 
@@ -1,5 +1,4 @@
 #version 330
-#define BONES_LIMIT 256
 
 layout(location = 0) in vec3 vPosition;
 layout(location = 1) in vec3 vNormal;
@@ -11,38 +10,62 @@ layout(location = 6) in vec4 vBones;
 layout(location = 7) in vec4 vBoneWeight;
 
 layout(location = 8) in mat4 vWorldTransform;
+layout(location = 12) in int vBoneOffset;
 
 uniform mat4 matWorld;
-uniform mat4 matView;
-uniform mat4 matProj;
+
+layout(std140) uniform FrameBlock
+{
+	mat4 matView;
+	mat4 matProj;
+	mat4 matViewProj;
+	vec3 vecViewPos;
+	float fArc; // tan(0.5 * fov)
+	vec4 vecFogColor; // rgb + density
+	vec4 vecClusterViewport; // xy: viewport origin, zw: tiles per pixel
+	ivec4 vecClusterSize; // tiles x, tiles y, depth slices, global lights
+	vec2 vecClusterDepth; // depth slice = log(depth) * x + y
+	int iLightCount;
+};
 
 uniform bool useInstancing = false;
 uniform bool useBones      = true;
+uniform int iBoneOffset    = 0; // without instancing
 
-layout(std140) uniform BoneBlock
-{
-	mat4 bones[BONES_LIMIT];
-};
+// Skinning matrices of all entities, 4 texels per bone
+uniform samplerBuffer texBones;
 
 out vec3 position, color, normal, tangent, cotangent;
 out vec2 uv0, uv1;
 
-vec4 applyBoneTransform(vec4 inval)
+mat4 fetchBone(float bone)
+{
+	int offset = useInstancing ? vBoneOffset : iBoneOffset;
+	int texel = 4 * (offset + int(bone));
+	return mat4(
+		texelFetch(texBones, texel + 0),
+		texelFetch(texBones, texel + 1),
+		texelFetch(texBones, texel + 2),
+		texelFetch(texBones, texel + 3));
+}
+
+mat4 skinTransform()
 {
 	if(useBones == false)
-		return inval;
+		return mat4(1.0);
 	vec4 weights = vBoneWeight;
-	return weights.x * bones[int(vBones.x)] * inval
-		 + weights.y * bones[int(vBones.y)] * inval
-		 + weights.z * bones[int(vBones.z)] * inval
-		 + weights.w * bones[int(vBones.w)] * inval;
+	return weights.x * fetchBone(vBones.x)
+		 + weights.y * fetchBone(vBones.y)
+		 + weights.z * fetchBone(vBones.z)
+		 + weights.w * fetchBone(vBones.w);
 }
 
 void main() {
 
-	vec3 mPosition = applyBoneTransform(vec4(vPosition, 1.0)).xyz;
-	vec3 mNormal   = applyBoneTransform(vec4(vNormal, 0.0)).xyz;
-	vec3 mTangent  = applyBoneTransform(vec4(vTangent, 0.0)).xyz;
+	mat4 skin = skinTransform();
+	vec3 mPosition = (skin * vec4(vPosition, 1.0)).xyz;
+	vec3 mNormal   = (skin * vec4(vNormal, 0.0)).xyz;
+	vec3 mTangent  = (skin * vec4(vTangent, 0.0)).xyz;
 
 	mat4 world;
 	if(useInstancing)
@@ -51,7 +74,7 @@ void main() {
 		world = matWorld;
 
 	position = (world * vec4(mPosition, 1)).rgb;
-	gl_Position = matProj * matView * vec4(position, 1);
+	gl_Position = matViewProj * vec4(position, 1);
 	normal = normalize(( world * vec4(mNormal, 0.0) ).xyz);
 	tangent = normalize(( world * vec4(mTangent, 0.0) ).xyz);
 	color = vColor;
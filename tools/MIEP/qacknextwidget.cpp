@@ -66,13 +66,19 @@ void QAcknextWidget::drawBones()
 	mat_id(&mat);
 
 	MATRIX animatedBones[ACKNEXT_MAX_BONES];
-	for(int i = 0; i < ACKNEXT_MAX_BONES; i++)
+	for(int i = 0; i < model()->boneCount; i++)
 	{
 		MATRIX & transform = animatedBones[i];
+		if(i >= this->mModelDisplay->poseCount) {
+			// Models without skeleton have no pose
+			transform = model()->bones[i].transform;
+			continue;
+		}
+		FRAME const & frame = this->mModelDisplay->pose[i];
 		mat_id(&transform);
-		mat_translate(&transform, &this->mModelDisplay->pose[i].position);
-		mat_rotate(&transform, &this->mModelDisplay->pose[i].rotation);
-		mat_scale(&transform, &this->mModelDisplay->pose[i].scale);
+		mat_translate(&transform, &frame.position);
+		mat_rotate(&transform, &frame.rotation);
+		mat_scale(&transform, &frame.scale);
 	}
 
 	MATRIX transforms[ACKNEXT_MAX_BONES];
@@ -0,0 +1,38 @@
+#include "bench.hpp"
+
+#include <atomic>
+
+// The program's own malloc family takes precedence over the one of the
+// C library for the engine libraries too, so every heap allocation of
+// the process is counted. Everything is forwarded to glibc.
+extern "C"
+{
+	void * __libc_malloc(size_t size);
+	void * __libc_calloc(size_t count, size_t size);
+	void * __libc_realloc(void * ptr, size_t size);
+
+	static std::atomic<size_t> allocations(0);
+
+	void * malloc(size_t size)
+	{
+		allocations.fetch_add(1, std::memory_order_relaxed);
+		return __libc_malloc(size);
+	}
+
+	void * calloc(size_t count, size_t size)
+	{
+		allocations.fetch_add(1, std::memory_order_relaxed);
+		return __libc_calloc(count, size);
+	}
+
+	void * realloc(void * ptr, size_t size)
+	{
+		allocations.fetch_add(1, std::memory_order_relaxed);
+		return __libc_realloc(ptr, size);
+	}
+}
+
+size_t bench_allocations()
+{
+	return allocations.load();
+}
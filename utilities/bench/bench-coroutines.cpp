@@ -0,0 +1,40 @@
+#include "bench.hpp"
+#include <coroutine.h>
+
+#define COROUTINES 1000
+#define YIELDS     1000
+
+static void yielder(struct schedule * S, void *)
+{
+	for(int i = 0; i < YIELDS; i++)
+		coroutine_yield(S);
+}
+
+// Round robin over many coroutines that only yield, so the result is
+// the cost of one resume and yield pair. Building the scheduler addon
+// with COROUTINE_UCONTEXT defined gives the swapcontext numbers.
+void bench_coroutines()
+{
+	struct schedule * S = coroutine_open_ex(32 * 1024);
+	int ids[COROUTINES];
+
+	// Every run starts fresh coroutines, the stacks come from the pool
+	double ms = bench_time(5, [&]() {
+		for(int i = 0; i < COROUTINES; i++)
+			ids[i] = coroutine_new(S, yielder, nullptr);
+		for(bool alive = true; alive; )
+		{
+			alive = false;
+			for(int i = 0; i < COROUTINES; i++)
+			{
+				if(coroutine_status(S, ids[i]) == COROUTINE_DEAD)
+					continue;
+				coroutine_resume(S, ids[i]);
+				alive = true;
+			}
+		}
+	});
+	bench_report("coroutines/switch", 1e6 * ms / (COROUTINES * (YIELDS + 1)), "ns");
+
+	coroutine_close(S);
+}
@@ -0,0 +1,25 @@
+#include "bench.hpp"
+#include "graphics/scene/drawlist.hpp"
+
+void bench_drawlist()
+{
+	static size_t const sizes[] = { 1000, 10000, 100000 };
+
+	MATRIX const matViewProj = bench_viewproj(0);
+	VECTOR const origin = { 0, 0, 0 };
+
+	for(size_t count : sizes)
+	{
+		bench_populate(count);
+
+		DrawList list;
+		double ms = bench_time(100000 / count + 10, [&]() {
+			list.build(matViewProj, origin, nullptr);
+		});
+
+		char name[64];
+		sprintf(name, "drawlist/build/%zu", count);
+		bench_report(name, list.drawcalls() / ms, "drawcalls/ms");
+	}
+	bench_clear();
+}
@@ -0,0 +1,36 @@
+#include "bench.hpp"
+#include "core/jobsystem.hpp"
+
+#include <math.h>
+
+// Runs the same parallelFor on 1 to 16 threads, the calling thread
+// included. Speedup is relative to the single thread run.
+void bench_jobs()
+{
+	static int const threadCounts[] = { 1, 2, 4, 8, 16 };
+	size_t const count = 1 << 22;
+
+	std::vector<float> values(count);
+	double single = 0;
+	for(int threads : threadCounts)
+	{
+		bench_workers(threads - 1);
+
+		double ms = bench_time(20, [&]() {
+			JobSystem::parallelFor(count, 4096, [&](size_t begin, size_t end, int)
+			{
+				for(size_t i = begin; i < end; i++)
+					values[i] = sqrtf(float(i)) * sinf(float(i));
+			});
+		});
+		if(threads == 1)
+			single = ms;
+
+		char name[64];
+		sprintf(name, "jobs/parallelfor/%d", threads);
+		bench_report(name, ms, "ms");
+		sprintf(name, "jobs/speedup/%d", threads);
+		bench_report(name, single / ms, "x");
+	}
+	bench_workers(-1);
+}
@@ -0,0 +1,46 @@
+#include "bench.hpp"
+#include "graphics/scene/lightclusters.hpp"
+
+#include <math.h>
+
+// Point lights spread over the view of bench_camera(0), like the
+// entities of bench_populate.
+static void createLights(std::vector<LightClusters::Sphere> & lights, size_t count)
+{
+	float const slope = tanf(float(0.5 * DEG_TO_RAD * BENCH_FOV));
+	lights.resize(count);
+	for(size_t i = 0; i < count; i++)
+	{
+		float depth = bench_random(1.0f, 0.5f * BENCH_FAR);
+		lights[i].position = (VECTOR) {
+			bench_random(-1.0f, 1.0f) * slope * depth,
+			bench_random(-1.0f, 1.0f) * slope * depth,
+			-depth,
+		};
+		lights[i].radius = bench_random(1.0f, 25.0f);
+		lights[i].light = i;
+	}
+}
+
+void bench_lights()
+{
+	static size_t const sizes[] = { 1000, 4000, 16000 };
+
+	MATRIX matView, matProj;
+	bench_camera(0, &matView, &matProj);
+
+	std::vector<LightClusters::Sphere> lights;
+	LightClusters clusters;
+	for(size_t count : sizes)
+	{
+		createLights(lights, count);
+
+		double ms = bench_time(20, [&]() {
+			clusters.build(matView, matProj, BENCH_NEAR, BENCH_FAR, lights.data(), lights.size());
+		});
+
+		char name[64];
+		sprintf(name, "lights/clusters/%zu", count);
+		bench_report(name, ms, "ms");
+	}
+}
@@ -0,0 +1,115 @@
+#include "bench.hpp"
+#include <acknext/acff.h>
+#include <acknext/serialization.h>
+
+#include <string>
+#include <string.h>
+
+// One million vertices and triangles
+#define MESH_VERTICES  (1 << 20)
+#define MESH_INDICES   (3 << 20)
+
+static MESH * createMesh()
+{
+	BUFFER * vertexBuffer = buffer_create(VERTEXBUFFER);
+	buffer_set(vertexBuffer, MESH_VERTICES * sizeof(VERTEX), nullptr);
+	VERTEX * vertices = (VERTEX*)buffer_map(vertexBuffer, WRITEONLY);
+	for(int i = 0; i < MESH_VERTICES; i++)
+	{
+		VERTEX & vertex = vertices[i];
+		memset(&vertex, 0, sizeof(VERTEX));
+		vertex.position = (VECTOR) { float(i % 1024), float(i / 1024), 0 };
+		vertex.normal = (VECTOR) { 0, 0, 1 };
+		vertex.tangent = (VECTOR) { 1, 0, 0 };
+		vertex.color = (COLOR) { 1, 1, 1, 1 };
+		vertex.boneWeights.values[0] = 255;
+	}
+	buffer_unmap(vertexBuffer);
+
+	BUFFER * indexBuffer = buffer_create(INDEXBUFFER);
+	buffer_set(indexBuffer, MESH_INDICES * sizeof(INDEX), nullptr);
+	INDEX * indices = (INDEX*)buffer_map(indexBuffer, WRITEONLY);
+	for(int i = 0; i < MESH_INDICES; i++)
+		indices[i] = (i / 3 + i % 3) % MESH_VERTICES;
+	buffer_unmap(indexBuffer);
+
+	MESH * mesh = mesh_create(GL_TRIANGLES, vertexBuffer, indexBuffer);
+	mesh_updateBoundingBox(mesh);
+	return mesh;
+}
+
+static void removeMesh(MESH * mesh)
+{
+	buffer_remove(mesh->vertexBuffer);
+	buffer_remove(mesh->indexBuffer);
+	mesh_remove(mesh);
+}
+
+// The element by element layout mesh_write produced before the packed chunk
+static void writeLegacy(ACKFILE * file, MESH const * mesh)
+{
+	file_write_header(file, TYPE_MESH, acff_guidMesh);
+	file_write_uint32(file, mesh->primitiveType);
+	file_write_uint32(file, MESH_INDICES);
+	file_write_uint32(file, MESH_VERTICES);
+	file_write_uint32(file, mesh->lodMask);
+
+	INDEX const * indices = (INDEX const *)buffer_map(mesh->indexBuffer, READONLY);
+	for(int i = 0; i < MESH_INDICES; i++)
+		file_write_uint32(file, indices[i]);
+	buffer_unmap(mesh->indexBuffer);
+
+	VERTEX const * vertices = (VERTEX const *)buffer_map(mesh->vertexBuffer, READONLY);
+	for(int i = 0; i < MESH_VERTICES; i++)
+	{
+		file_write_vector(file, vertices[i].position);
+		file_write_vector(file, vertices[i].normal);
+		file_write_vector(file, vertices[i].tangent);
+		file_write_color(file, vertices[i].color);
+		file_write_uv(file, vertices[i].texcoord0);
+		file_write_uv(file, vertices[i].texcoord1);
+		file_write(file, vertices[i].bones.values, 4);
+		file_write(file, vertices[i].boneWeights.values, 4);
+	}
+	buffer_unmap(mesh->vertexBuffer);
+}
+
+static double timeLoad(std::string const & fileName)
+{
+	return bench_time(5, [&]() {
+		ACKFILE * file = file_open_read(fileName.c_str());
+		MESH * mesh = mesh_read(file);
+		file_close(file);
+		assert(mesh != nullptr);
+		removeMesh(mesh);
+	});
+}
+
+// Loads a mesh with 1M vertices and triangles from a plain file,
+// stored in the legacy and in the packed layout.
+void bench_meshes()
+{
+	std::string const legacyName = std::string(P_tmpdir) + "/ackbench-legacy.amd";
+	std::string const packedName = std::string(P_tmpdir) + "/ackbench-packed.amd";
+
+	MESH * mesh = createMesh();
+
+	ACKFILE * file = file_open_write(legacyName.c_str());
+	writeLegacy(file, mesh);
+	file_close(file);
+
+	file = file_open_write(packedName.c_str());
+	mesh_write(file, mesh);
+	file_close(file);
+
+	removeMesh(mesh);
+
+	double legacy = timeLoad(legacyName);
+	bench_report("meshes/load/legacy", legacy, "ms");
+	double packed = timeLoad(packedName);
+	bench_report("meshes/load/packed", packed, "ms");
+	bench_report("meshes/speedup", legacy / packed, "x");
+
+	remove(legacyName.c_str());
+	remove(packedName.c_str());
+}
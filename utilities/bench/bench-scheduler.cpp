@@ -0,0 +1,74 @@
+#include "bench.hpp"
+#include <acknext/ext/scheduler.h>
+
+static void spin(void *)
+{
+	for(;;)
+		task_yield();
+}
+
+// Every task stack is mapped with a guard page, so each task takes two
+// of the memory mappings a process is allowed to have.
+static size_t mappingsNeeded(size_t tasks)
+{
+	return 2 * tasks + 4096;
+}
+
+static bool enoughMappings(size_t tasks)
+{
+	FILE * file = fopen("/proc/sys/vm/max_map_count", "r");
+	if(file == nullptr)
+		return true;
+	long limit = 0;
+	if(fscanf(file, "%ld", &limit) != 1)
+		limit = 0;
+	fclose(file);
+	return limit <= 0 || mappingsNeeded(tasks) < size_t(limit);
+}
+
+// Cost of one scheduler_update with all tasks yielding every frame,
+// and with all tasks masked out by tasks_enabled.
+void bench_scheduler()
+{
+	static size_t const sizes[] = { 100, 1000, 10000, 100000 };
+
+	task_stack_size = 32 * 1024;
+	scheduler_init();
+
+	for(size_t count : sizes)
+	{
+		char name[64];
+		sprintf(name, "scheduler/update/%zu", count);
+		if(!enoughMappings(count)) {
+			char reason[64];
+			sprintf(reason, "needs vm.max_map_count > %zu", mappingsNeeded(count));
+			bench_skip(name, reason);
+			continue;
+		}
+
+		std::vector<TASK*> tasks(count);
+		for(size_t i = 0; i < count; i++)
+			tasks[i] = task_defer(spin, nullptr);
+
+		double ms = bench_time(20, []() {
+			scheduler_update();
+		});
+		bench_report(name, ms, "ms");
+		sprintf(name, "scheduler/pertask/%zu", count);
+		bench_report(name, 1e6 * ms / count, "ns");
+
+		tasks_enabled = 0;
+		ms = bench_time(20, []() {
+			scheduler_update();
+		});
+		tasks_enabled = BITFIELD_ALL;
+		sprintf(name, "scheduler/masked/%zu", count);
+		bench_report(name, ms, "ms");
+
+		for(TASK * task : tasks)
+			task_kill(task);
+		scheduler_update();
+	}
+
+	scheduler_shutdown();
+}
@@ -0,0 +1,41 @@
+#include "bench.hpp"
+#include "scene/entitystorage.hpp"
+#include "graphics/scene/drawlist.hpp"
+
+// Keeps the compiler from dropping the loops
+static volatile var sink;
+
+// Walks the entities through the ENTITY list and through the packed
+// arrays, then culls all of them with the camera facing away.
+void bench_storage()
+{
+	size_t const count = 100000;
+	bench_populate(count);
+	EntityStorage::refreshAll();
+
+	double ms = bench_time(50, []() {
+		var sum = 0;
+		for(ENTITY * ent = ent_next(nullptr); ent != nullptr; ent = ent_next(ent))
+			sum += ent->position.x;
+		sink = sum;
+	});
+	bench_report("storage/iterate/list", count / ms, "entities/ms");
+
+	ms = bench_time(50, []() {
+		var sum = 0;
+		for(VECTOR const & position : EntityStorage::positions)
+			sum += position.x;
+		sink = sum;
+	});
+	bench_report("storage/iterate/packed", count / ms, "entities/ms");
+
+	MATRIX const matViewProj = bench_viewproj(180);
+	VECTOR const origin = { 0, 0, 0 };
+	DrawList list;
+	ms = bench_time(50, [&]() {
+		list.build(matViewProj, origin, nullptr);
+	});
+	bench_report("storage/cull/drawlist", count / ms, "entities/ms");
+
+	bench_clear();
+}
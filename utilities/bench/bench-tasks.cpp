@@ -0,0 +1,36 @@
+#include "bench.hpp"
+#include <acknext/ext/scheduler.h>
+
+static void shortLived(void *)
+{
+
+}
+
+// Spawns short lived tasks every frame, which die in task_start and
+// are retired by the next scheduler_update. After the warm-up frames
+// the task and coroutine pools must serve all of them.
+void bench_tasks()
+{
+	int const perFrame = 1000;
+	int const frames = 100;
+
+	task_stack_size = 32 * 1024;
+	scheduler_init();
+
+	auto frame = [&]() {
+		for(int i = 0; i < perFrame; i++)
+			task_start(shortLived, nullptr);
+		scheduler_update();
+	};
+
+	double ms = bench_time(frames, frame);
+	bench_report("tasks/spawn", 1000.0 * perFrame / ms, "tasks/s");
+
+	size_t before = bench_allocations();
+	for(int i = 0; i < frames; i++)
+		frame();
+	size_t after = bench_allocations();
+	bench_report("tasks/steady/allocations", double(after - before) / (frames * perFrame), "mallocs/task");
+
+	scheduler_shutdown();
+}
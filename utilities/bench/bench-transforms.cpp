@@ -0,0 +1,30 @@
+#include "bench.hpp"
+#include "scene/entitystorage.hpp"
+
+// Refreshes the cached transforms when all, a tenth or none of the
+// entities moved. All moving is the cost of recomputing every frame.
+void bench_transforms()
+{
+	static int const percentages[] = { 100, 10, 0 };
+	size_t const count = 100000;
+
+	bench_populate(count);
+	std::vector<ENTITY*> const & entities = bench_entities();
+
+	for(int percent : percentages)
+	{
+		size_t const moving = count * percent / 100;
+		var delta = 0.01;
+		double ms = bench_time(50, [&]() {
+			delta = -delta;
+			for(size_t i = 0; i < moving; i++)
+				entities[i]->position.x += delta;
+			EntityStorage::refreshAll();
+		});
+
+		char name[64];
+		sprintf(name, "transforms/refresh/%d%%", percent);
+		bench_report(name, ms, "ms");
+	}
+	bench_clear();
+}
@@ -0,0 +1,62 @@
+#ifndef BENCH_HPP
+#define BENCH_HPP
+
+#include <engine.hpp>
+
+#include <chrono>
+#include <vector>
+#include <stdio.h>
+
+// Milliseconds per call of fn, averaged over iterations after a warm-up call
+template<typename F>
+static inline double bench_time(int iterations, F const & fn)
+{
+	fn();
+	auto start = std::chrono::steady_clock::now();
+	for(int i = 0; i < iterations; i++)
+		fn();
+	std::chrono::duration<double, std::milli> time = std::chrono::steady_clock::now() - start;
+	return time.count() / iterations;
+}
+
+// Number of malloc, calloc and realloc calls of the whole process so far
+size_t bench_allocations();
+
+// Replaces the GL buffer functions with ones working on plain memory,
+// so BUFFER objects can be created, mapped and filled without GL
+void bench_cpubuffers();
+
+// Prints one result line: name, value and unit
+void bench_report(char const * name, double value, char const * unit);
+
+// Prints that the benchmark was skipped and why
+void bench_skip(char const * name, char const * reason);
+
+// Restarts the job system with count worker threads
+void bench_workers(int count);
+
+// Replaces the scene with count entities spread over the view of
+// bench_viewproj(0). The entities share a few models and materials
+// whose meshes have no buffers, so no GL context is needed.
+void bench_populate(size_t count);
+
+void bench_clear();
+
+// Entities of the current scene in creation order
+std::vector<ENTITY*> const & bench_entities();
+
+// Camera at the origin, turned around the up axis by yaw degrees
+MATRIX bench_viewproj(var yaw);
+
+// View and projection of bench_viewproj(yaw) on their own
+void bench_camera(var yaw, MATRIX * matView, MATRIX * matProj);
+
+// Pseudo random number in [min, max), bench_populate resets the sequence
+float bench_random(float min, float max);
+
+// Camera of bench_viewproj and bench_camera
+#define BENCH_FOV  60.0f
+#define BENCH_NEAR 0.1f
+#define BENCH_FAR  1000.0f
+
+#endif // BENCH_HPP
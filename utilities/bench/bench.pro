@@ -0,0 +1,37 @@
+TEMPLATE = app
+CONFIG += console c++11
+CONFIG -= app_bundle
+CONFIG -= qt
+
+# CPU-only benchmarks of the engine internals. No window or GL context
+# is created, the engine parts are driven directly through their classes.
+
+CONFIG += acknext-scheduler
+
+include($$TOPDIR/acknext/acknext.pri)
+include($$TOPDIR/addons/addons.pri)
+
+# Internal engine headers
+INCLUDEPATH += $$TOPDIR/acknext/src
+DEFINES += _ACKNEXT_INTERNAL_
+
+# The coroutine library is linked into the scheduler addon
+INCLUDEPATH += $$TOPDIR/extern/coroutine/include
+
+SOURCES += \
+	main.cpp \
+	allocations.cpp \
+	cpubuffers.cpp \
+	scene.cpp \
+	bench-drawlist.cpp \
+	bench-transforms.cpp \
+	bench-storage.cpp \
+	bench-jobs.cpp \
+	bench-scheduler.cpp \
+	bench-tasks.cpp \
+	bench-meshes.cpp \
+	bench-coroutines.cpp \
+	bench-lights.cpp
+
+HEADERS += \
+	bench.hpp
@@ -0,0 +1,54 @@
+#include "bench.hpp"
+
+#include <string.h>
+
+// Buffer objects kept in plain memory. Only the calls the BUFFER api
+// makes are replaced, everything else of GL stays unusable.
+static std::vector<std::vector<uint8_t>> storage(1);
+
+static void APIENTRY createBuffers(GLsizei n, GLuint * buffers)
+{
+	for(GLsizei i = 0; i < n; i++)
+	{
+		buffers[i] = GLuint(storage.size());
+		storage.emplace_back();
+	}
+}
+
+static void APIENTRY deleteBuffers(GLsizei n, GLuint const * buffers)
+{
+	for(GLsizei i = 0; i < n; i++)
+		std::vector<uint8_t>().swap(storage[buffers[i]]);
+}
+
+static void APIENTRY namedBufferData(GLuint buffer, GLsizeiptr size, void const * data, GLenum)
+{
+	storage[buffer].resize(size_t(size));
+	if(data != nullptr)
+		memcpy(storage[buffer].data(), data, size_t(size));
+}
+
+static void APIENTRY namedBufferSubData(GLuint buffer, GLintptr offset, GLsizeiptr size, void const * data)
+{
+	memcpy(storage[buffer].data() + offset, data, size_t(size));
+}
+
+static void * APIENTRY mapNamedBuffer(GLuint buffer, GLenum)
+{
+	return storage[buffer].data();
+}
+
+static GLboolean APIENTRY unmapNamedBuffer(GLuint)
+{
+	return GL_TRUE;
+}
+
+void bench_cpubuffers()
+{
+	gl3wProcs.gl.CreateBuffers = createBuffers;
+	gl3wProcs.gl.DeleteBuffers = deleteBuffers;
+	gl3wProcs.gl.NamedBufferData = namedBufferData;
+	gl3wProcs.gl.NamedBufferSubData = namedBufferSubData;
+	gl3wProcs.gl.MapNamedBuffer = mapNamedBuffer;
+	gl3wProcs.gl.UnmapNamedBuffer = unmapNamedBuffer;
+}
@@ -0,0 +1,82 @@
+#include "bench.hpp"
+#include "core/jobsystem.hpp"
+#include <acknext/extension.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+extern EXTENSION acknextDefaultSerializers;
+
+void bench_drawlist();
+void bench_transforms();
+void bench_storage();
+void bench_jobs();
+void bench_scheduler();
+void bench_tasks();
+void bench_meshes();
+void bench_coroutines();
+void bench_lights();
+
+struct
+{
+	char const * name;
+	void (*run)();
+} benchmarks[] = {
+	{ "drawlist", bench_drawlist },
+	{ "transforms", bench_transforms },
+	{ "storage", bench_storage },
+	{ "jobs", bench_jobs },
+	{ "scheduler", bench_scheduler },
+	{ "tasks", bench_tasks },
+	{ "meshes", bench_meshes },
+	{ "coroutines", bench_coroutines },
+	{ "lights", bench_lights },
+	{ NULL, NULL }
+};
+
+void bench_report(char const * name, double value, char const * unit)
+{
+	printf("%-36s %14.3f %s\n", name, value, unit);
+	fflush(stdout);
+}
+
+void bench_skip(char const * name, char const * reason)
+{
+	printf("%-36s skipped, %s\n", name, reason);
+	fflush(stdout);
+}
+
+void bench_workers(int count)
+{
+	JobSystem::shutdown();
+	engine_config.workerThreads = count;
+	JobSystem::initialize();
+}
+
+// Runs all benchmarks, or only the ones whose name
+// starts with one of the arguments
+int main(int argc, char ** argv)
+{
+	engine_config.argv0 = argv[0];
+
+	// Plain files, the virtual file system is not initialized
+	engine_config.flags &= ~USE_VFS;
+
+	ext_register("ACKNEXT SYSTEM", &acknextDefaultSerializers);
+	bench_cpubuffers();
+
+	JobSystem::initialize();
+
+	for(int i = 0; benchmarks[i].name != NULL; i++)
+	{
+		bool selected = (argc < 2);
+		for(int j = 1; j < argc; j++)
+			selected |= (strncmp(benchmarks[i].name, argv[j], strlen(argv[j])) == 0);
+		if(selected)
+			benchmarks[i].run();
+	}
+
+	bench_clear();
+	JobSystem::shutdown();
+	return EXIT_SUCCESS;
+}
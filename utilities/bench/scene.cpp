@@ -0,0 +1,99 @@
+#include "bench.hpp"
+#include "graphics/scene/ackglm.hpp"
+
+#define BENCH_MODELS    8
+#define BENCH_MATERIALS 4
+#define BENCH_DEPTH     500.0f
+
+static std::vector<ENTITY*> entities;
+static MODEL * models[BENCH_MODELS];
+static MATERIAL * materials[BENCH_MATERIALS];
+
+// Deterministic, so runs are comparable
+static uint32_t seed = 1;
+
+float bench_random(float min, float max)
+{
+	seed = 1664525u * seed + 1013904223u;
+	return min + (max - min) * float(seed >> 8) / float(1 << 24);
+}
+
+static MODEL * createModel(int index)
+{
+	MODEL * model = model_create(2, 0, 0);
+	for(int i = 0; i < model->meshCount; i++)
+	{
+		MESH * mesh = mesh_create(GL_TRIANGLES, nullptr, nullptr);
+		mesh->boundingBox.minimum = (VECTOR) { -1, -1, -1 };
+		mesh->boundingBox.maximum = (VECTOR) {  1,  1,  1 };
+		model->meshes[i] = mesh;
+		model->materials[i] = materials[(index + i) % BENCH_MATERIALS];
+	}
+	model_updateBoundingBox(model, false);
+	return model;
+}
+
+void bench_populate(size_t count)
+{
+	if(models[0] == nullptr)
+	{
+		for(int i = 0; i < BENCH_MATERIALS; i++)
+			materials[i] = mtl_create();
+		for(int i = 0; i < BENCH_MODELS; i++)
+			models[i] = createModel(i);
+	}
+
+	bench_clear();
+	seed = 1;
+
+	// Inside the view frustum, which looks down -Z
+	float const slope = tanf(float(0.5 * DEG_TO_RAD * BENCH_FOV));
+	entities.reserve(count);
+	for(size_t i = 0; i < count; i++)
+	{
+		float depth = bench_random(5.0f, BENCH_DEPTH);
+		VECTOR position = {
+			bench_random(-0.8f, 0.8f) * slope * depth,
+			bench_random(-0.8f, 0.8f) * slope * depth,
+			-depth,
+		};
+		ENTITY * ent = ent_create(nullptr, &position, nullptr);
+		ent->model = models[i % BENCH_MODELS];
+		entities.push_back(ent);
+	}
+}
+
+void bench_clear()
+{
+	for(ENTITY * ent : entities)
+		ent_remove(ent);
+	entities.clear();
+}
+
+std::vector<ENTITY*> const & bench_entities()
+{
+	return entities;
+}
+
+static glm::mat4 view(var yaw)
+{
+	return glm::rotate(glm::mat4(), float(-DEG_TO_RAD * yaw), glm::vec3(0, 1, 0));
+}
+
+static glm::mat4 projection()
+{
+	return glm::perspectiveFov(float(DEG_TO_RAD * BENCH_FOV), 16.0f, 9.0f, BENCH_NEAR, BENCH_FAR);
+}
+
+MATRIX bench_viewproj(var yaw)
+{
+	MATRIX result;
+	glm_to_ack(&result, projection() * view(yaw));
+	return result;
+}
+
+void bench_camera(var yaw, MATRIX * matView, MATRIX * matProj)
+{
+	glm_to_ack(matView, view(yaw));
+	glm_to_ack(matProj, projection());
+}
@@ -1,7 +1,8 @@
 TEMPLATE = subdirs
 
 SUBDIRS += \
-    ackgimp
+    ackgimp \
+	bench
 
 DISTFILES += \
     ackmagic/magic